@@ -0,0 +1,526 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include <unistd.h> /* getpid */
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "llvm/Constants.h"
+#include "llvm/Function.h"
+#include "llvm/Module.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/InstIterator.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
+
+#include "AnalysisCache.h"
+#include "../Support/Stats.h"
+
+using namespace llvm;
+using namespace llvm::cache;
+
+static cl::opt<bool>
+UseCache("analysis-cache",
+         cl::desc("Keep points-to sets, callgraph and mod-sets on disk next "
+                  "to the module and reuse them"));
+
+static cl::opt<std::string>
+CacheDir("analysis-cache-dir",
+         cl::desc("Directory of the analysis cache (implies "
+                  "-analysis-cache)"),
+         cl::value_desc("directory"));
+
+static stats::Counter CacheHits("cache.hits",
+    "Analyses loaded from the cache");
+static stats::Counter CacheMisses("cache.misses",
+    "Analyses computed and cached");
+
+namespace {
+  typedef uint32_t Word;
+  typedef ptr::PointsToSets::Pointee Pointee;
+  typedef ptr::PointsToSets::PointsToSet PTSet;
+
+  /*
+   * The file is a sequence of native 32-bit words:
+   *   header (HDR_WORDS words), with the options which change the results
+   *   pointees: count, then <value, offset or lo, 0 or hi> for each
+   *   points-to sets: count, then <size, pointees...> for each
+   *   points-to map: count, then <pointer (a pointee), set> for each
+   *   with CALLGRAPH, direct calls: count, then <caller, callee> values
+   *   with MODIFIES, mod-sets as the points-to sets, then <function, set>
+   * Values are numbered by ModuleValues. A foreign byte order does not match
+   * the magic and is just a miss.
+   */
+  static const Word CACHE_MAGIC = 0x43414c53; /* "SLAC" */
+  static const Word CACHE_VERSION = 2;
+
+  enum {
+    HDR_MAGIC,
+    HDR_VERSION,
+    HDR_HASH_LO,
+    HDR_HASH_HI,
+    HDR_VALUES,
+    HDR_CONTENTS,
+    HDR_OPTIONS,
+    HDR_SIZE,
+    HDR_WORDS
+  };
+
+  /*
+   * Globals, functions, arguments and instructions in module order, then
+   * the null pointer constants the instructions use (the pointees of
+   * NULLPTR rules), 0 is null. The numbering is the same for the same
+   * bitcode.
+   */
+  class ModuleValues {
+  public:
+    explicit ModuleValues(const Module &M) {
+      add(0);
+      for (Module::const_global_iterator I = M.global_begin(),
+           E = M.global_end(); I != E; ++I)
+        add(&*I);
+      for (Module::const_iterator F = M.begin(), E = M.end(); F != E; ++F)
+        add(&*F);
+      for (Module::const_iterator F = M.begin(), E = M.end(); F != E; ++F) {
+        for (Function::const_arg_iterator A = F->arg_begin(),
+             AE = F->arg_end(); A != AE; ++A)
+          add(&*A);
+        for (const_inst_iterator I = inst_begin(&*F), IE = inst_end(&*F);
+             I != IE; ++I)
+          add(&*I);
+      }
+      for (Module::const_iterator F = M.begin(), E = M.end(); F != E; ++F)
+        for (const_inst_iterator I = inst_begin(&*F), IE = inst_end(&*F);
+             I != IE; ++I)
+          for (User::const_op_iterator O = I->op_begin(), OE = I->op_end();
+               O != OE; ++O)
+            if (isa<ConstantPointerNull>(*O) && !IDs.count(*O))
+              add(*O);
+    }
+
+    Word size() const { return Values.size(); }
+    const Value *get(Word I) const { return Values[I]; }
+
+    /* false for values which are not numbered, like constant expressions */
+    bool getID(const Value *V, Word &ID) const {
+      DenseMap<const Value *, Word>::const_iterator I = IDs.find(V);
+      if (I == IDs.end())
+        return false;
+      ID = I->second;
+      return true;
+    }
+
+  private:
+    void add(const Value *V) {
+      IDs[V] = Values.size();
+      Values.push_back(V);
+    }
+
+    std::vector<const Value *> Values;
+    DenseMap<const Value *, Word> IDs;
+  };
+
+  class Writer {
+  public:
+    explicit Writer(const ModuleValues &Vals) : Vals(Vals), OK(true) {}
+
+    bool ok() const { return OK; }
+
+    void push(Word W) { Body.push_back(W); }
+
+    void pushValue(const Value *V) {
+      Word ID = 0;
+      if (!Vals.getID(V, ID))
+        OK = false;
+      push(ID);
+    }
+
+    void pushPointee(const Pointee &P) {
+      std::pair<std::unordered_map<Pointee, Word>::iterator, bool> R =
+        PointeeIDs.insert(std::make_pair(P, (Word)PointeeIDs.size()));
+
+      if (R.second) {
+        Word ID = 0;
+        if (!Vals.getID(P.first, ID))
+          OK = false;
+        Pointees.push_back(ID);
+        if (ptr::PointeeRange::isRange(P.second)) {
+          ptr::PointeeRange::Range Rng = ptr::PointeeRange::decode(P.second);
+          Pointees.push_back(Rng.first);
+          Pointees.push_back(Rng.second);
+        } else {
+          Pointees.push_back(P.second);
+          Pointees.push_back(0);
+        }
+      }
+      push(R.first->second);
+    }
+
+    template<typename SetTy>
+    void pushSet(const SetTy &S) {
+      push(S.size());
+      for (typename SetTy::const_iterator I = S.begin(), E = S.end();
+           I != E; ++I)
+        pushPointee(*I);
+    }
+
+    /* header, pointee table and the body */
+    void finish(std::vector<Word> &Out, uint64_t Hash, unsigned Contents,
+                unsigned Options) {
+      Out.resize(HDR_WORDS);
+      Out[HDR_MAGIC] = CACHE_MAGIC;
+      Out[HDR_VERSION] = CACHE_VERSION;
+      Out[HDR_HASH_LO] = Hash;
+      Out[HDR_HASH_HI] = Hash >> 32;
+      Out[HDR_VALUES] = Vals.size();
+      Out[HDR_CONTENTS] = Contents;
+      Out[HDR_OPTIONS] = Options;
+      Out.push_back(PointeeIDs.size());
+      Out.insert(Out.end(), Pointees.begin(), Pointees.end());
+      Out.insert(Out.end(), Body.begin(), Body.end());
+      Out[HDR_SIZE] = Out.size();
+    }
+
+  private:
+    const ModuleValues &Vals;
+    std::unordered_map<Pointee, Word> PointeeIDs;
+    std::vector<Word> Pointees, Body;
+    bool OK;
+  };
+
+  /*
+   * Decodes the words of the file buffer, a truncated or otherwise bogus
+   * file only makes ok() false.
+   */
+  class Reader {
+  public:
+    Reader(const Word *Begin, const Word *End, const ModuleValues &Vals) :
+      Cur(Begin), End(End), Vals(Vals), OK(true) {}
+
+    bool ok() const { return OK; }
+    bool atEnd() const { return Cur == End; }
+    void fail() { OK = false; }
+
+    Word next() {
+      if (Cur == End) {
+        OK = false;
+        return 0;
+      }
+      return *Cur++;
+    }
+
+    /* count of N-word records, checked against the remaining size */
+    Word count(unsigned N) {
+      Word C = next();
+      if ((uint64_t)C * N > (uint64_t)(End - Cur)) {
+        OK = false;
+        return 0;
+      }
+      return C;
+    }
+
+    const Value *value() {
+      Word ID = next();
+      if (ID >= Vals.size()) {
+        OK = false;
+        return 0;
+      }
+      return Vals.get(ID);
+    }
+
+    void readPointees() {
+      for (Word I = 0, N = count(3); I < N && OK; ++I) {
+        const Value *V = value();
+        int A = next(), B = next();
+        if (B && (A < 0 || B <= A + 1)) {
+          OK = false;
+          break;
+        }
+        Pointees.push_back(Pointee(V, B ? ptr::PointeeRange::encode(A, B) :
+                                   A));
+      }
+    }
+
+    const Pointee &pointee() {
+      static const Pointee Null(0, -1);
+      Word ID = next();
+      if (ID >= Pointees.size()) {
+        OK = false;
+        return Null;
+      }
+      return Pointees[ID];
+    }
+
+    template<typename SetTy>
+    void readSet(SetTy &S) {
+      for (Word I = 0, N = count(1); I < N && OK; ++I)
+        S.insert(pointee());
+    }
+
+  private:
+    const Word *Cur, *End;
+    const ModuleValues &Vals;
+    std::vector<Pointee> Pointees;
+    bool OK;
+  };
+
+  uint64_t hashModule(const Module &M) {
+    std::string Bitcode;
+    {
+      raw_string_ostream OS(Bitcode);
+      WriteBitcodeToFile(&M, OS);
+    }
+
+    /* FNV-1a */
+    uint64_t H = 14695981039346656037ULL;
+    for (std::string::const_iterator I = Bitcode.begin(), E = Bitcode.end();
+         I != E; ++I) {
+      H ^= (unsigned char)*I;
+      H *= 1099511628211ULL;
+    }
+    return H;
+  }
+
+  std::string getCacheDir(const Module &M) {
+    if (!CacheDir.empty())
+      return CacheDir;
+
+    StringRef Dir = sys::path::parent_path(M.getModuleIdentifier());
+    return Dir.empty() ? "." : Dir.str();
+  }
+
+  std::string getCachePath(const Module &M, uint64_t Hash) {
+    StringRef Id = M.getModuleIdentifier();
+    std::string Name = Id.empty() || Id[0] == '<' ? "module" :
+      sys::path::filename(Id).str();
+    SmallString<128> Path(getCacheDir(M));
+
+    sys::path::append(Path, Name + "." + utohexstr(Hash) + ".slcache");
+    return Path.str();
+  }
+
+  bool load(const std::string &Path, const ModuleValues &Vals,
+            uint64_t Hash, Module &M, ProgramAnalyses &A, unsigned Needed) {
+    OwningPtr<MemoryBuffer> Buf;
+
+    /*
+     * Without a null terminator a big file can be mapped instead of read,
+     * but the load is not lazy: everything is decoded into A right away and
+     * nothing refers to the buffer when we return.
+     */
+    if (MemoryBuffer::getFile(Path, Buf, -1, false))
+      return false;
+
+    const Word *Begin = reinterpret_cast<const Word *>(Buf->getBufferStart());
+    std::size_t Size = Buf->getBufferSize() / sizeof(Word);
+
+    if (Size < HDR_WORDS || Begin[HDR_MAGIC] != CACHE_MAGIC ||
+        Begin[HDR_VERSION] != CACHE_VERSION ||
+        Begin[HDR_HASH_LO] != (Word)Hash ||
+        Begin[HDR_HASH_HI] != (Word)(Hash >> 32) ||
+        Begin[HDR_VALUES] != Vals.size() ||
+        (Begin[HDR_CONTENTS] & Needed) != Needed ||
+        Begin[HDR_OPTIONS] != ptr::getResultOptions() ||
+        Begin[HDR_SIZE] != Size)
+      return false;
+
+    unsigned Contents = Begin[HDR_CONTENTS];
+    Reader R(Begin + HDR_WORDS, Begin + Size, Vals);
+    R.readPointees();
+
+    std::vector<PTSet> Sets;
+    for (Word I = 0, N = R.count(1); I < N && R.ok(); ++I) {
+      ptr::PointeeSet S;
+      R.readSet(S);
+      Sets.push_back(PTSet(S));
+    }
+
+    for (Word I = 0, N = R.count(2); I < N && R.ok(); ++I) {
+      const Pointee &P = R.pointee();
+      Word S = R.next();
+      if (S >= Sets.size()) {
+        R.fail();
+        break;
+      }
+      A.PS[P] = Sets[S];
+    }
+
+    callgraph::Callgraph::Container Calls;
+    if (Contents & ProgramAnalyses::CALLGRAPH)
+      for (Word I = 0, N = R.count(2); I < N && R.ok(); ++I) {
+        const Function *Caller = dyn_cast_or_null<Function>(R.value());
+        const Function *Callee = dyn_cast_or_null<Function>(R.value());
+        if (!Caller || !Callee) {
+          R.fail();
+          break;
+        }
+        Calls.insert(std::make_pair(Caller, Callee));
+      }
+
+    if ((Contents & ProgramAnalyses::MODIFIES) == ProgramAnalyses::MODIFIES) {
+      std::vector<const mods::Modifies::ModSet *> ModSets;
+      for (Word I = 0, N = R.count(1); I < N && R.ok(); ++I) {
+        mods::Modifies::ModSet S;
+        R.readSet(S);
+        ModSets.push_back(A.MOD.intern(S));
+      }
+
+      for (Word I = 0, N = R.count(2); I < N && R.ok(); ++I) {
+        const Function *F = dyn_cast_or_null<Function>(R.value());
+        Word S = R.next();
+        if (!F || S >= ModSets.size()) {
+          R.fail();
+          break;
+        }
+        A.MOD[F] = ModSets[S];
+      }
+    }
+
+    if (!R.ok() || !R.atEnd()) {
+      A.PS.getContainer().clear();
+      A.MOD.getContainer().clear();
+      return false;
+    }
+
+    if (Needed & ProgramAnalyses::CALLGRAPH)
+      A.CG.reset(new callgraph::Callgraph(M, Calls));
+
+    return true;
+  }
+
+  void store(const std::string &Path, const Module &M,
+             const ModuleValues &Vals, uint64_t Hash,
+             const ProgramAnalyses &A, unsigned Contents) {
+    Writer W(Vals);
+
+    /* the sets are shared, write each of them once */
+    DenseMap<const void *, Word> SetIDs;
+    std::vector<const PTSet *> Sets;
+    for (ptr::PointsToSets::const_iterator I = A.PS.begin(), E = A.PS.end();
+         I != E; ++I)
+      if (SetIDs.insert(std::make_pair(I->second.getIdentity(),
+                                       (Word)Sets.size())).second)
+        Sets.push_back(&I->second);
+
+    W.push(Sets.size());
+    for (std::vector<const PTSet *>::const_iterator I = Sets.begin(),
+         E = Sets.end(); I != E; ++I)
+      W.pushSet(**I);
+
+    W.push(A.PS.getContainer().size());
+    for (ptr::PointsToSets::const_iterator I = A.PS.begin(), E = A.PS.end();
+         I != E; ++I) {
+      W.pushPointee(I->first);
+      W.push(SetIDs[I->second.getIdentity()]);
+    }
+
+    if (Contents & ProgramAnalyses::CALLGRAPH) {
+      const callgraph::Callgraph::Container &Calls = A.CG->getContainer();
+      W.push(Calls.size());
+      for (callgraph::Callgraph::const_iterator I = Calls.begin(),
+           E = Calls.end(); I != E; ++I) {
+        W.pushValue(I->first);
+        W.pushValue(I->second);
+      }
+    }
+
+    if ((Contents & ProgramAnalyses::MODIFIES) == ProgramAnalyses::MODIFIES) {
+      DenseMap<const void *, Word> ModIDs;
+      std::vector<const mods::Modifies::ModSet *> ModSets;
+      for (mods::Modifies::const_iterator I = A.MOD.begin(),
+           E = A.MOD.end(); I != E; ++I)
+        if (ModIDs.insert(std::make_pair((const void *)I->second,
+                                         (Word)ModSets.size())).second)
+          ModSets.push_back(I->second);
+
+      W.push(ModSets.size());
+      for (std::vector<const mods::Modifies::ModSet *>::const_iterator
+           I = ModSets.begin(), E = ModSets.end(); I != E; ++I)
+        W.pushSet(**I);
+
+      W.push(A.MOD.getContainer().size());
+      for (mods::Modifies::const_iterator I = A.MOD.begin(),
+           E = A.MOD.end(); I != E; ++I) {
+        W.pushValue(I->first);
+        W.push(ModIDs[I->second]);
+      }
+    }
+
+    if (!W.ok()) {
+      errs() << "WARNING[AnalysisCache]: results of " <<
+        M.getModuleIdentifier() << " refer to unnumbered values, "
+        "not cached\n";
+      return;
+    }
+
+    std::vector<Word> Words;
+    W.finish(Words, Hash, Contents, ptr::getResultOptions());
+
+    if (!CacheDir.empty()) {
+      bool Existed;
+      sys::fs::create_directories(Twine(CacheDir), Existed);
+    }
+
+    /* write aside and rename, so that readers never see a partial file */
+    std::string Tmp = Path + ".tmp" + utostr(getpid());
+    std::string Err;
+    {
+      raw_fd_ostream OS(Tmp.c_str(), Err, raw_fd_ostream::F_Binary);
+      if (Err.empty())
+        OS.write(reinterpret_cast<const char *>(&Words[0]),
+                 Words.size() * sizeof(Word));
+    }
+
+    if (!Err.empty() || sys::fs::rename(Twine(Tmp), Twine(Path))) {
+      errs() << "WARNING[AnalysisCache]: cannot write " << Path;
+      if (!Err.empty())
+        errs() << ": " << Err;
+      errs() << '\n';
+      bool Existed;
+      sys::fs::remove(Twine(Tmp), Existed);
+    }
+  }
+
+  void compute(Module &M, ProgramAnalyses &A, unsigned Needed) {
+    {
+      ptr::ProgramStructure P(M);
+      computePointsToSets(P, A.PS);
+    }
+
+    if (Needed & ProgramAnalyses::CALLGRAPH)
+      A.CG.reset(new callgraph::Callgraph(M, A.PS));
+
+    if ((Needed & ProgramAnalyses::MODIFIES) == ProgramAnalyses::MODIFIES) {
+      mods::ProgramStructure P1(M);
+      computeModifies(P1, *A.CG, A.PS, A.MOD);
+    }
+  }
+}
+
+void cache::computeAnalyses(Module &M, ProgramAnalyses &A, unsigned Needed) {
+  if (!UseCache && CacheDir.empty()) {
+    compute(M, A, Needed);
+    return;
+  }
+
+  ModuleValues Vals(M);
+  uint64_t Hash = hashModule(M);
+  std::string Path = getCachePath(M, Hash);
+
+  if (load(Path, Vals, Hash, M, A, Needed)) {
+    ++CacheHits;
+    return;
+  }
+
+  ++CacheMisses;
+  compute(M, A, Needed);
+  store(Path, M, Vals, Hash, A, Needed);
+}
@@ -0,0 +1,41 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#ifndef CACHE_ANALYSISCACHE_H
+#define CACHE_ANALYSISCACHE_H
+
+#include "llvm/Module.h"
+#include "llvm/ADT/OwningPtr.h"
+
+#include "../Callgraph/Callgraph.h"
+#include "../Modifies/Modifies.h"
+#include "../PointsTo/PointsTo.h"
+
+namespace llvm { namespace cache {
+
+  ///
+  // Whole-program analyses the passes need. With -analysis-cache (or
+  // -analysis-cache-dir=), they are stored in a binary file keyed by a hash
+  // of the module and later runs on the same module with the same
+  // result-changing options (ptr::getResultOptions) load them instead of
+  // computing them again.
+  ///
+  struct ProgramAnalyses {
+    enum {
+      POINTS_TO = 0,
+      CALLGRAPH = 1,
+      MODIFIES = 2 | CALLGRAPH
+    };
+
+    ptr::PointsToSets PS;
+    OwningPtr<callgraph::Callgraph> CG; /* with CALLGRAPH */
+    mods::Modifies MOD;                 /* with MODIFIES */
+  };
+
+  // Fill A with what Needed asks for, from the cache if possible.
+  void computeAnalyses(Module &M, ProgramAnalyses &A,
+                       unsigned Needed = ProgramAnalyses::MODIFIES);
+
+}}
+
+#endif
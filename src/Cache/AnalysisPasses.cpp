@@ -0,0 +1,209 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+#include "llvm/DataLayout.h"
+#include "llvm/Instructions.h"
+#include "llvm/Module.h"
+#include "llvm/Support/InstIterator.h"
+
+#include "AnalysisCache.h"
+#include "AnalysisPasses.h"
+#include "../Support/Stats.h"
+
+using namespace llvm;
+using namespace llvm::cache;
+
+static RegisterPass<PointsToAnalysis> X("points-to",
+                                        "Computes points-to sets",
+                                        false, true);
+char PointsToAnalysis::ID;
+
+static RegisterPass<CallgraphAnalysis> Y("slicer-callgraph",
+                                         "Computes the slicer's callgraph",
+                                         false, true);
+char CallgraphAnalysis::ID;
+
+static RegisterPass<ModifiesAnalysis> Z("modifies",
+                                        "Computes mod-sets of functions",
+                                        false, true);
+char ModifiesAnalysis::ID;
+
+static stats::Counter Reused("cache.reused",
+    "Analyses reused since their input is the same");
+
+namespace {
+  /*
+   * Everything an analysis reads from the module, as a flat list of
+   * pointers and tags. Equal inputs give equal results, since the analyses
+   * depend on the IR only through these.
+   */
+  typedef std::vector<const void *> Input;
+  /* results of other analyses an Input refers to by their address */
+  typedef std::vector<std::shared_ptr<const void> > Inputs;
+
+  const void *tag(uintptr_t t) {
+    return reinterpret_cast<const void *>(t);
+  }
+
+  template<typename T>
+  struct LastResult {
+    LastResult() : M(0) {}
+
+    std::shared_ptr<const T> reuse(const Module &Mod, const Input &In) const {
+      if (!Result || M != &Mod || Key != In)
+        return std::shared_ptr<const T>();
+      ++Reused;
+      return Result;
+    }
+
+    void remember(const Module &Mod, Input &In, const Inputs &Deps,
+                  const std::shared_ptr<const T> &R) {
+      M = &Mod;
+      Key.swap(In);
+      this->Deps = Deps;
+      Result = R;
+    }
+
+    const Module *M;
+    Input Key;
+    /*
+     * Kept alive with the key, so that no other result is allocated at an
+     * address the key holds while it can still match.
+     */
+    Inputs Deps;
+    std::shared_ptr<const T> Result;
+  };
+
+  /*
+   * What the points-to analysis reads of a rule besides its operands: the
+   * offset of a GEP and the size of allocated memory. The operand pointers
+   * alone do not tell a GEP changed in place, or another instruction
+   * allocated at the address of a freed one.
+   */
+  void addRuleShape(Input &In, const DataLayout &DL,
+                    const ptr::RuleCode &RC) {
+    const Value *Ops[] = { RC.getLvalue(), RC.getRvalue() };
+
+    for (unsigned i = 0; i < 2; ++i) {
+      const Value *V = Ops[i];
+      if (!V)
+        continue;
+
+      In.push_back(V->getType());
+
+      uint64_t Size;
+      In.push_back(tag(ptr::getAllocatedSize(DL, V, Size) ? Size + 1 : 0));
+
+      if (const GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(V)) {
+        bool isArray = false;
+        In.push_back(tag(ptr::accumulateConstantOffset(GEP, DL, isArray)));
+        In.push_back(tag(isArray));
+        In.push_back(GEP->getPointerOperand());
+      }
+    }
+  }
+
+  LastResult<ptr::PointsToSets> LastPointsTo;
+  LastResult<callgraph::Callgraph> LastCallgraph;
+  LastResult<mods::Modifies> LastModifies;
+}
+
+void cache::forgetResults() {
+  LastPointsTo = LastResult<ptr::PointsToSets>();
+  LastCallgraph = LastResult<callgraph::Callgraph>();
+  LastModifies = LastResult<mods::Modifies>();
+}
+
+bool PointsToAnalysis::runOnModule(Module &M) {
+  Input In;
+  {
+    ptr::ProgramStructure P(M);
+    DataLayout DL(&M);
+    for (ptr::ProgramStructure::const_iterator I = P.begin(), E = P.end();
+         I != E; ++I) {
+      In.push_back(tag(I->getType()));
+      In.push_back(I->getLvalue());
+      In.push_back(I->getRvalue());
+      addRuleShape(In, DL, *I);
+    }
+  }
+
+  PS = LastPointsTo.reuse(M, In);
+  if (PS)
+    return false;
+
+  ProgramAnalyses A;
+  computeAnalyses(M, A, ProgramAnalyses::POINTS_TO);
+
+  std::shared_ptr<ptr::PointsToSets> R(new ptr::PointsToSets);
+  R->getContainer().swap(A.PS.getContainer());
+  PS = R;
+
+  LastPointsTo.remember(M, In, Inputs(), PS);
+  return false;
+}
+
+bool CallgraphAnalysis::runOnModule(Module &M) {
+  std::shared_ptr<const ptr::PointsToSets> PS =
+    getAnalysis<PointsToAnalysis>().getResult();
+  Input In;
+
+  In.push_back(PS.get());
+  for (Module::const_iterator F = M.begin(), FE = M.end(); F != FE; ++F) {
+    In.push_back(&*F);
+    for (const_inst_iterator I = inst_begin(&*F), E = inst_end(&*F);
+         I != E; ++I)
+      if (const CallInst *CI = dyn_cast<CallInst>(&*I)) {
+        In.push_back(CI);
+        In.push_back(CI->getCalledValue());
+      }
+  }
+
+  CG = LastCallgraph.reuse(M, In);
+  if (CG)
+    return false;
+
+  CG.reset(new callgraph::Callgraph(M, *PS));
+
+  LastCallgraph.remember(M, In, Inputs(1, PS), CG);
+  return false;
+}
+
+bool ModifiesAnalysis::runOnModule(Module &M) {
+  std::shared_ptr<const ptr::PointsToSets> PS =
+    getAnalysis<PointsToAnalysis>().getResult();
+  std::shared_ptr<const callgraph::Callgraph> CG =
+    getAnalysis<CallgraphAnalysis>().getResult();
+  mods::ProgramStructure P(M);
+  Input In;
+
+  In.push_back(PS.get());
+  In.push_back(CG.get());
+  for (mods::ProgramStructure::const_iterator F = P.begin(), FE = P.end();
+       F != FE; ++F) {
+    In.push_back(F->first);
+    for (mods::ProgramStructure::Commands::const_iterator C =
+         F->second.begin(), E = F->second.end(); C != E; ++C) {
+      In.push_back(tag(C->getType()));
+      In.push_back(C->getVar());
+    }
+  }
+
+  MOD = LastModifies.reuse(M, In);
+  if (MOD)
+    return false;
+
+  std::shared_ptr<mods::Modifies> R(new mods::Modifies);
+  computeModifies(P, *CG, *PS, *R);
+  MOD = R;
+
+  Inputs Deps;
+  Deps.push_back(PS);
+  Deps.push_back(CG);
+  LastModifies.remember(M, In, Deps, MOD);
+  return false;
+}
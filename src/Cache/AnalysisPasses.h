@@ -0,0 +1,94 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#ifndef CACHE_ANALYSISPASSES_H
+#define CACHE_ANALYSISPASSES_H
+
+#include <memory>
+
+#include "llvm/Pass.h"
+
+#include "../Callgraph/Callgraph.h"
+#include "../Modifies/Modifies.h"
+#include "../PointsTo/PointsTo.h"
+
+namespace llvm { namespace cache {
+
+  ///
+  // The whole-program analyses as analysis passes, so that transforms can
+  // require them and one pass manager run shares them. The pass manager
+  // runs them again after every module pass which does not preserve them.
+  // The previous results are then reused as long as the IR the analysis
+  // reads (pointer rules, call sites, stores) did not change.
+  ///
+  class PointsToAnalysis : public ModulePass {
+  public:
+    static char ID;
+
+    PointsToAnalysis() : ModulePass(ID) {}
+
+    virtual bool runOnModule(Module &M);
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.setPreservesAll();
+    }
+    virtual void releaseMemory() { PS.reset(); }
+
+    const ptr::PointsToSets &getPointsToSets() const { return *PS; }
+    std::shared_ptr<const ptr::PointsToSets> getResult() const { return PS; }
+
+  private:
+    std::shared_ptr<const ptr::PointsToSets> PS;
+  };
+
+  class CallgraphAnalysis : public ModulePass {
+  public:
+    static char ID;
+
+    CallgraphAnalysis() : ModulePass(ID) {}
+
+    virtual bool runOnModule(Module &M);
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.setPreservesAll();
+      AU.addRequired<PointsToAnalysis>();
+    }
+    virtual void releaseMemory() { CG.reset(); }
+
+    const callgraph::Callgraph &getCallgraph() const { return *CG; }
+    std::shared_ptr<const callgraph::Callgraph> getResult() const {
+      return CG;
+    }
+
+  private:
+    std::shared_ptr<const callgraph::Callgraph> CG;
+  };
+
+  class ModifiesAnalysis : public ModulePass {
+  public:
+    static char ID;
+
+    ModifiesAnalysis() : ModulePass(ID) {}
+
+    virtual bool runOnModule(Module &M);
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.setPreservesAll();
+      AU.addRequired<PointsToAnalysis>();
+      AU.addRequired<CallgraphAnalysis>();
+    }
+    virtual void releaseMemory() { MOD.reset(); }
+
+    const mods::Modifies &getModifies() const { return *MOD; }
+    std::shared_ptr<const mods::Modifies> getResult() const { return MOD; }
+
+  private:
+    std::shared_ptr<const mods::Modifies> MOD;
+  };
+
+  // Drops the results the passes above keep for reuse. Tools running them
+  // over many modules call it before freeing a module, so that the memory
+  // is returned and a later module allocated at the same addresses cannot
+  // be taken for the old one.
+  void forgetResults();
+
+}}
+
+#endif
@@ -2,24 +2,49 @@
 // License. See LICENSE.TXT for details.
 
 #include "../PointsTo/PointsTo.h"
+#include "../Support/Trace.h"
 #include "Callgraph.h"
 
 using namespace llvm;
 using namespace callgraph;
 
 Callgraph::Callgraph(Module &M, ptr::PointsToSets const& PS) {
-  typedef Module::iterator FunctionsIter;
-  for (FunctionsIter f = M.begin(); f != M.end(); ++f)
-    if (!f->isDeclaration() && !memoryManStuff(&*f))
-      for (inst_iterator i = inst_begin(*f); i != inst_end(*f); i++)
-	if (const CallInst *CI = dyn_cast<CallInst const>(&*i))
-	  handleCall(&*f, CI, PS);
-
-  detail::computeTransitiveClosure(directCallsMap, callsMap);
+  trace::Scope T("callgraph");
+
+  numberFunctions(M);
+
+  for (unsigned i = 0; i < funs.size(); ++i) {
+    const Function *f = funs[i];
+    for (const_inst_iterator I = inst_begin(f), E = inst_end(f); I != E; ++I)
+      if (const CallInst *CI = dyn_cast<CallInst const>(&*I))
+	handleCall(f, CI, PS);
+  }
+
+  finish();
+}
+
+Callgraph::Callgraph(Module &M, const Container &directCalls) :
+    directCallsMap(directCalls) {
+  trace::Scope T("callgraph");
+
+  numberFunctions(M);
+  finish();
+}
+
+void Callgraph::numberFunctions(Module &M) {
+  for (Module::const_iterator f = M.begin(); f != M.end(); ++f)
+    if (!f->isDeclaration() && !memoryManStuff(&*f)) {
+      funIndex[&*f] = funs.size();
+      funs.push_back(&*f);
+    }
+}
+
+void Callgraph::finish() {
   for (const_iterator it = begin(); it != end(); ++it)
     directCalleesMap.insert(value_type(it->second,it->first));
-  for (const_iterator it = callsMap.begin(); it != callsMap.end(); ++it)
-    calleesMap.insert(value_type(it->second,it->first));
+
+  computeSCCs();
+  computeReachedBy();
 }
 
 void Callgraph::handleCall(const Function *parent,
@@ -40,3 +65,181 @@ void Callgraph::handleCall(const Function *parent,
       insertDirectCall(value_type(parent, called));
   }
 }
+
+/*
+ * Tarjan's algorithm, iterative so that long call chains do not exhaust the
+ * stack. SCCs are emitted callees first, so the reachability of an SCC is
+ * computed right away from the already finished SCCs it calls.
+ */
+void Callgraph::computeSCCs() {
+  trace::Scope T("callgraph.closure");
+  static const unsigned UNVISITED = ~0U;
+  unsigned N = funs.size();
+  std::vector<std::vector<unsigned> > succs(N);
+
+  for (unsigned v = 0; v < N; ++v) {
+    range_iterator R = directCalls(funs[v]);
+    for (const_iterator I = R.first; I != R.second; ++I)
+      succs[v].push_back(funIndex[I->second]);
+  }
+
+  std::vector<unsigned> index(N, UNVISITED), low(N), comp(N);
+  std::vector<bool> onStack(N);
+  std::vector<unsigned> stack;
+  std::vector<std::pair<unsigned, unsigned> > calls; /* node, next succ */
+  unsigned counter = 0;
+
+  for (unsigned r = 0; r < N; ++r) {
+    if (index[r] != UNVISITED)
+      continue;
+
+    index[r] = low[r] = counter++;
+    stack.push_back(r);
+    onStack[r] = true;
+    calls.push_back(std::make_pair(r, 0));
+
+    while (!calls.empty()) {
+      unsigned v = calls.back().first;
+
+      if (calls.back().second < succs[v].size()) {
+	unsigned w = succs[v][calls.back().second++];
+
+	if (index[w] == UNVISITED) {
+	  index[w] = low[w] = counter++;
+	  stack.push_back(w);
+	  onStack[w] = true;
+	  calls.push_back(std::make_pair(w, 0));
+	} else if (onStack[w])
+	  low[v] = std::min(low[v], index[w]);
+	continue;
+      }
+
+      calls.pop_back();
+      if (!calls.empty()) {
+	unsigned u = calls.back().first;
+	low[u] = std::min(low[u], low[v]);
+      }
+
+      if (low[v] != index[v])
+	continue;
+
+      /* v is the root of an SCC */
+      std::vector<unsigned> members;
+      unsigned w;
+      do {
+	w = stack.back();
+	stack.pop_back();
+	onStack[w] = false;
+	comp[w] = SCCs.size();
+	members.push_back(w);
+      } while (w != v);
+
+      /* keep the module order inside of the SCC */
+      std::sort(members.begin(), members.end());
+
+      unsigned height = 0;
+      SCCs.push_back(SCC());
+      SCCReach.push_back(FunctionSet());
+      FunctionSet &reach = SCCReach.back();
+      for (std::vector<unsigned>::const_iterator I = members.begin(),
+	   E = members.end(); I != E; ++I) {
+	SCCs.back().push_back(funs[*I]);
+	SCCIndex[funs[*I]] = comp[*I];
+
+	for (std::vector<unsigned>::const_iterator S = succs[*I].begin(),
+	     SE = succs[*I].end(); S != SE; ++S) {
+	  reach.set(*S);
+	  if (comp[*S] != comp[*I]) {
+	    height = std::max(height, SCCHeights[comp[*S]] + 1);
+	    reach |= SCCReach[comp[*S]];
+	  }
+	}
+      }
+      SCCHeights.push_back(height);
+    }
+  }
+}
+
+/*
+ * The same as SCCReach, but over the callers, so SCCs are walked callers
+ * first.
+ */
+void Callgraph::computeReachedBy() {
+  trace::Scope T("callgraph.reverse-closure");
+
+  SCCReachedBy.resize(SCCs.size());
+
+  for (unsigned s = SCCs.size(); s-- > 0; ) {
+    FunctionSet &reached = SCCReachedBy[s];
+
+    for (SCC::const_iterator I = SCCs[s].begin(), E = SCCs[s].end();
+	 I != E; ++I) {
+      range_iterator R = directCallees(*I);
+      for (const_iterator C = R.first; C != R.second; ++C) {
+	unsigned caller = funIndex.find(C->second)->second;
+	unsigned scc = SCCIndex.find(C->second)->second;
+
+	reached.set(caller);
+	if (scc != s)
+	  reached |= SCCReachedBy[scc];
+      }
+    }
+  }
+}
+
+const Callgraph::FunctionSet &Callgraph::getEmptySet() {
+  static const FunctionSet empty;
+  return empty;
+}
+
+const Callgraph::FunctionSet &Callgraph::getClosureSet(unsigned fun,
+						       bool reverse) const {
+  unsigned scc = SCCIndex.find(funs[fun])->second;
+
+  return reverse ? SCCReachedBy[scc] : SCCReach[scc];
+}
+
+Callgraph::closure_range Callgraph::closureOf(const Function *f,
+					      bool reverse) const {
+  DenseMap<const Function *, unsigned>::const_iterator I = funIndex.find(f);
+
+  /* declarations are not in the callgraph */
+  if (I == funIndex.end())
+    return closure_range(closure_iterator(), closure_iterator());
+
+  return closure_range(closure_iterator(this, I->second, I->second + 1,
+					reverse),
+		       closure_iterator(this, I->second + 1, I->second + 1,
+					reverse));
+}
+
+Callgraph::closure_iterator::closure_iterator(const Callgraph *CG,
+					      unsigned key, unsigned keyEnd,
+					      bool reverse) :
+    CG(CG), key(key), keyEnd(keyEnd), reverse(reverse),
+    bit(getEmptySet().begin()), bitEnd(bit) {
+  if (key < keyEnd) {
+    const FunctionSet &S = CG->getClosureSet(key, reverse);
+    bit = S.begin();
+    bitEnd = S.end();
+  }
+  settle();
+}
+
+/*
+ * Move to the next existing pair, keys with nothing reachable are skipped.
+ */
+void Callgraph::closure_iterator::settle() {
+  while (key < keyEnd) {
+    if (bit != bitEnd) {
+      cur = std::make_pair(CG->funs[key], CG->funs[*bit]);
+      return;
+    }
+
+    if (++key < keyEnd) {
+      const FunctionSet &S = CG->getClosureSet(key, reverse);
+      bit = S.begin();
+      bitEnd = S.end();
+    }
+  }
+}
@@ -8,8 +8,11 @@
 #include <algorithm>
 #include <iterator>
 #include <utility>
+#include <vector>
 
 #include "llvm/Function.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SparseBitVector.h"
 #include "llvm/ADT/STLExtras.h" /* tie */
 
 #include "../Languages/LLVM.h"
@@ -27,8 +30,55 @@ namespace llvm { namespace callgraph {
         typedef Container::iterator iterator;
         typedef Container::const_iterator const_iterator;
         typedef std::pair<const_iterator,const_iterator> range_iterator;
+        typedef std::vector<const llvm::Function *> SCC;
+        typedef std::vector<SCC> SCCList;
+        // set of function numbers
+        typedef llvm::SparseBitVector<> FunctionSet;
+
+        // Walks (key, function) pairs of the transitive closure. It is not
+        // stored as pairs, they are generated from the per-SCC reachability
+        // sets on the fly.
+        class closure_iterator :
+          public std::iterator<std::forward_iterator_tag,
+                               const std::pair<const llvm::Function *,
+                                               const llvm::Function *> > {
+        public:
+          closure_iterator() : CG(0), key(0), keyEnd(0), reverse(false),
+            bit(getEmptySet().begin()), bitEnd(bit) {}
+          closure_iterator(const Callgraph *CG, unsigned key, unsigned keyEnd,
+                           bool reverse);
+
+          reference operator*() const { return cur; }
+          pointer operator->() const { return &cur; }
+
+          closure_iterator &operator++() { ++bit; settle(); return *this; }
+          closure_iterator operator++(int) {
+            closure_iterator tmp = *this;
+            ++*this;
+            return tmp;
+          }
+
+          bool operator==(const closure_iterator &RHS) const {
+            return key == RHS.key && (key == keyEnd || bit == RHS.bit);
+          }
+          bool operator!=(const closure_iterator &RHS) const {
+            return !(*this == RHS);
+          }
+
+        private:
+          void settle();
+
+          const Callgraph *CG;
+          unsigned key, keyEnd;
+          bool reverse;
+          FunctionSet::iterator bit, bitEnd;
+          std::pair<const llvm::Function *, const llvm::Function *> cur;
+        };
+        typedef std::pair<closure_iterator, closure_iterator> closure_range;
 
         Callgraph(Module &M, const llvm::ptr::PointsToSets &PS);
+        // from known direct calls, e.g. loaded from the analysis cache
+        Callgraph(Module &M, const Container &directCalls);
 
         range_iterator directCalls(key_type const& key) const
         { return directCallsMap.equal_range(key); }
@@ -36,11 +86,13 @@ namespace llvm { namespace callgraph {
         range_iterator directCallees(key_type const& key) const
         { return directCalleesMap.equal_range(key); }
 
-        range_iterator calls(key_type const& key) const
-        { return callsMap.equal_range(key); }
+        // functions transitively called from key
+        closure_range calls(key_type const& key) const
+        { return closureOf(key, false); }
 
-        range_iterator callees(key_type const& key) const
-        { return calleesMap.equal_range(key); }
+        // functions transitively calling key
+        closure_range callees(key_type const& key) const
+        { return closureOf(key, true); }
 
         bool contains(key_type const key, mapped_type const value) const {
           range_iterator rng = directCalls(key);
@@ -54,11 +106,31 @@ namespace llvm { namespace callgraph {
         iterator begin() { return directCallsMap.begin(); }
         const_iterator end() const { return directCallsMap.end(); }
         iterator end() { return directCallsMap.end(); }
-        const_iterator begin_closure() const { return callsMap.begin(); }
-        const_iterator end_closure() const { return callsMap.end(); }
+        closure_iterator begin_closure() const
+        { return closure_iterator(this, 0, funs.size(), false); }
+        closure_iterator end_closure() const
+        { return closure_iterator(this, funs.size(), funs.size(), false); }
         Container const& getContainer() const { return directCallsMap; }
         Container& getContainer() { return directCallsMap; }
 
+        // strongly connected components of direct calls, every SCC comes
+        // after all the SCCs it calls into (callees first)
+        SCCList const& getSCCs() const { return SCCs; }
+        // index of the SCC of a defined function in getSCCs()
+        unsigned getSCCIndex(const llvm::Function *f) const {
+          llvm::DenseMap<const llvm::Function *, unsigned>::const_iterator I =
+            SCCIndex.find(f);
+          assert(I != SCCIndex.end() && "Function not in the callgraph");
+          return I->second;
+        }
+        // 0 for SCCs calling no other SCC, otherwise 1 + the maximum of the
+        // called SCCs. SCCs of the same height never call each other.
+        unsigned getSCCHeight(unsigned scc) const { return SCCHeights[scc]; }
+        bool isRecursive(unsigned scc) const {
+          return SCCs[scc].size() > 1 ||
+            contains(SCCs[scc].front(), SCCs[scc].front());
+        }
+
     protected:
         iterator insertDirectCall(value_type const& val)
         { return directCallsMap.insert(val); }
@@ -66,48 +138,32 @@ namespace llvm { namespace callgraph {
     private:
         Container directCallsMap;
         Container directCalleesMap;
-        Container callsMap;
-        Container calleesMap;
-
+        SCCList SCCs;
+        std::vector<unsigned> SCCHeights;
+        llvm::DenseMap<const llvm::Function *, unsigned> SCCIndex;
+
+        // defined functions, numbered as in the module
+        std::vector<const llvm::Function *> funs;
+        llvm::DenseMap<const llvm::Function *, unsigned> funIndex;
+        // functions reachable from an SCC by at least one call
+        std::vector<FunctionSet> SCCReach;
+        // functions reaching an SCC; computed with the rest in finish, so
+        // that a finished callgraph is never written and can be shared by
+        // threads
+        std::vector<FunctionSet> SCCReachedBy;
+
+        static const FunctionSet &getEmptySet();
+        void numberFunctions(Module &M);
+        void finish();
+        void computeSCCs();
+        void computeReachedBy();
+        const FunctionSet &getClosureSet(unsigned fun, bool reverse) const;
+        closure_range closureOf(const llvm::Function *f, bool reverse) const;
         void handleCall(const llvm::Function *parent, const llvm::CallInst *CI,
                         const llvm::ptr::PointsToSets &PS);
     };
 }}
 
-namespace llvm { namespace callgraph { namespace detail {
-
-  template<typename Relation>
-  void computeTransitiveClosure(Relation const& R, Relation& TCR) {
-    typedef std::set<typename Relation::value_type> Set;
-    typedef std::multimap<typename Relation::value_type::first_type,
-                          typename Relation::value_type::second_type> Dict;
-
-    Set S;
-    std::copy(R.begin(),R.end(),std::inserter(S,S.end()));
-
-    Dict D;
-    std::copy(R.begin(),R.end(),std::inserter(D,D.end()));
-
-    while (true)
-    {
-      std::size_t const old_size = S.size();
-
-      for (typename Set::const_iterator it = S.begin(); it != S.end(); ++it) {
-        typename Dict::const_iterator b,e;
-        llvm::tie(b,e) = D.equal_range(it->second);
-        for ( ; b != e; ++b)
-          S.insert(typename Set::value_type(it->first,b->second));
-      }
-
-      if (old_size == S.size())
-          break;
-    }
-
-    std::copy(S.begin(),S.end(),std::inserter(TCR,TCR.end()));
-  }
-
-}}}
-
 namespace llvm { namespace callgraph {
 
     static inline Callgraph::range_iterator
@@ -120,12 +176,12 @@ namespace llvm { namespace callgraph {
         return CG.directCallees(key);
     }
 
-    static inline Callgraph::range_iterator
+    static inline Callgraph::closure_range
     getCalls(Callgraph::key_type const& key, Callgraph const& CG) {
         return CG.calls(key);
     }
 
-    static inline Callgraph::range_iterator
+    static inline Callgraph::closure_range
     getCallees(Callgraph::key_type const& key, Callgraph const& CG) {
         return CG.callees(key);
     }
@@ -11,6 +11,7 @@
 #include "llvm/Support/InstIterator.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include "Cache/AnalysisPasses.h"
 #include "Callgraph/Callgraph.h"
 #include "PointsTo/PointsTo.h"
 #include "Slicing/Prepare.h"
@@ -29,6 +30,7 @@ namespace {
     virtual void getAnalysisUsage(AnalysisUsage &AU) const {
       AU.setPreservesAll();
       AU.addRequired<DataLayout>();
+      AU.addRequired<cache::CallgraphAnalysis>();
     }
   };
 }
@@ -36,7 +38,7 @@ namespace {
 class Kleerer {
 public:
   Kleerer(ModulePass &modPass, Module &M, DataLayout &TD,
-          callgraph::Callgraph &CG) : modPass(modPass),
+          const callgraph::Callgraph &CG) : modPass(modPass),
       M(M), TD(TD), CG(CG), C(M.getContext()), intPtrTy(TD.getIntPtrType(C)),
       done(false) {
     voidPtrType = TypeBuilder<void *, false>::get(C);
@@ -51,7 +53,7 @@ private:
   ModulePass &modPass;
   Module &M;
   DataLayout &TD;
-  callgraph::Callgraph &CG;
+  const callgraph::Callgraph &CG;
   LLVMContext &C;
   IntegerType *intPtrTy;
   bool done;
@@ -417,7 +419,7 @@ bool Kleerer::run() {
   if (!F__assert_fail) /* nothing to find here bro */
     return false;
 
-  callgraph::Callgraph::range_iterator RI = CG.callees(F__assert_fail);
+  callgraph::Callgraph::closure_range RI = CG.callees(F__assert_fail);
   if (std::distance(RI.first, RI.second) == 0)
     return false;
 
@@ -430,7 +432,7 @@ bool Kleerer::run() {
     assert(CE->getOpcode() == Instruction::BitCast);
     Function &F = *cast<Function>(CE->getOperand(0));
 
-    callgraph::Callgraph::const_iterator II, EE;
+    callgraph::Callgraph::closure_iterator II, EE;
     llvm::tie(II, EE) = CG.calls(&F);
     for (; II != EE; ++II) {
       const Function *callee = (*II).second;
@@ -447,13 +449,8 @@ bool Kleerer::run() {
 
 bool KleererPass::runOnModule(Module &M) {
   DataLayout &TD = getAnalysis<DataLayout>();
-  ptr::PointsToSets PS;
-  {
-    ptr::ProgramStructure P(M);
-    computePointsToSets(P, PS);
-  }
-
-  callgraph::Callgraph CG(M, PS);
+  const callgraph::Callgraph &CG =
+    getAnalysis<cache::CallgraphAnalysis>().getCallgraph();
 
   Kleerer K(*this, M, TD, CG);
   return K.run();
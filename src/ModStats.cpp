@@ -8,6 +8,7 @@
 #include "llvm/Support/InstIterator.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include "Cache/AnalysisPasses.h"
 #include "Callgraph/Callgraph.h"
 #include "PointsTo/PointsTo.h"
 #include "Slicing/Prepare.h"
@@ -26,6 +27,7 @@ namespace {
     virtual void getAnalysisUsage(AnalysisUsage &AU) const {
       AU.setPreservesAll();
       AU.addRequired<LoopInfo>();
+      AU.addRequired<cache::CallgraphAnalysis>();
     }
   };
 }
@@ -254,17 +256,12 @@ getFlags(const FunInfo *funInfo, bool nested = false) {
 }
 
 void StatsComputer::run() {
-  ptr::PointsToSets PS;
-  {
-    ptr::ProgramStructure P(M);
-    computePointsToSets(P, PS);
-  }
-
-  callgraph::Callgraph CG(M, PS);
+  const callgraph::Callgraph &CG =
+    modPass.getAnalysis<cache::CallgraphAnalysis>().getCallgraph();
   ModInfo modInfo(M);
 
 #ifdef DEBUG_DUMP_CALLREL
-  for (callgraph::Callgraph::const_iterator I = CG.begin_closure(),
+  for (callgraph::Callgraph::closure_iterator I = CG.begin_closure(),
 		  E = CG.end_closure(); I != E; ++I) {
 	  const Function *from = I->first;
 	  const Function *to = I->second;
@@ -288,7 +285,7 @@ void StatsComputer::run() {
     assert(CE->getOpcode() == Instruction::BitCast);
     const Function &F = *cast<Function>(CE->getOperand(0));
     FunInfo *funInfo = modInfo.getFunInfo(&F);
-    callgraph::Callgraph::const_iterator II, EE;
+    callgraph::Callgraph::closure_iterator II, EE;
     llvm::tie(II, EE) = CG.calls(&F);
 #ifdef DEBUG_NESTED
     errs() << "at " << F.getName() << " flags [" << getFlags(funInfo) << "]\n";
@@ -11,6 +11,7 @@
 
 #include "../Callgraph/Callgraph.h"
 #include "../PointsTo/PointsTo.h"
+#include "../Support/Trace.h"
 #include "Modifies.h"
 
 using namespace llvm;
@@ -33,21 +34,47 @@ namespace llvm { namespace mods {
     static const Modifies::ModSet empty;
     const Modifies::const_iterator it = S.find(f);
 
-    return (it == S.end()) ? empty : it->second;
+    return (it == S.end()) ? empty : *it->second;
   }
 
+  namespace {
+    typedef Modifies::ModSet ModSet;
 
+    /* adds what From modifies to To as seen by F, i.e. without F's locals */
+    bool addNonLocal(ModSet &To, const ModSet &From, const Function *F) {
+      bool changed = false;
+
+      for (ModSet::const_iterator I = From.begin(), E = From.end(); I != E;
+	   ++I)
+	if (!isLocalToFunction(I->first, F) && To.insert(*I).second)
+	  changed = true;
+
+      return changed;
+    }
+  }
+
+
+  /*
+   * The functions' own writes are computed first, then the callgraph SCCs
+   * are processed callees first. A function adds only the sets of its
+   * direct callees, which are final by then, except for callees in the
+   * same (recursive) SCC where we iterate to a fixpoint. The results are
+   * interned, so functions modifying the same share one set.
+   */
   void computeModifies(const ProgramStructure &P,
 	const callgraph::Callgraph &CG, const ptr::PointsToSets &PS,
 	Modifies &MOD) {
     typedef ptr::PointsToSets::Pointee Pointee;
+    typedef std::map<const Function *, ModSet> OwnMap;
+    OwnMap own;
+    trace::Scope T("modifies");
 
     for (ProgramStructure::const_iterator f = P.begin(); f != P.end(); ++f)
       for (ProgramStructure::mapped_type::const_iterator c = f->second.begin();
 	   c != f->second.end(); ++c)
 	if (c->getType() == CMD_VAR) {
 	  if (!isLocalToFunction(c->getVar(), f->first))
-	      MOD[f->first].insert(Pointee(c->getVar(), -1));
+	      own[f->first].insert(Pointee(c->getVar(), -1));
 	} else if (c->getType() == CMD_DREF_VAR) {
 	  typedef ptr::PointsToSets::PointsToSet PTSet;
 	  const PTSet &S = ptr::getPointsToSet(c->getVar(), PS);
@@ -55,38 +82,57 @@ namespace llvm { namespace mods {
 	  for (PTSet::const_iterator p = S.begin(); p != S.end(); ++p)
 	    if (!isLocalToFunction(p->first, f->first) &&
 			    !isConstantValue(p->first))
-	      MOD[f->first].insert(*p);
+	      own[f->first].insert(*p);
 	}
 
     typedef callgraph::Callgraph Callgraph;
-    for (Callgraph::const_iterator i = CG.begin_closure();
-	  i != CG.end_closure(); ++i) {
-      const Modifies::mapped_type &src = MOD[i->second];
-      typedef Modifies::mapped_type dst_t;
-      dst_t &dst = MOD[i->first];
-
-      std::copy(src.begin(), src.end(), std::inserter(dst, dst.end()));
-#if 0 /* original boost+STL uncompilable crap */
-      using std::tr1::bind;
-      using std::tr1::placeholders::_1;
-      using std::tr1::cref;
-      dst.erase(std::remove_if(dst.begin(), dst.end(),
-		bind(&ProgramStructure::isLocalToFunction, cref(P), _1, i->first)),
-		dst.end());
-#endif
-      for (dst_t::iterator I = dst.begin(), E = dst.end(); I != E; ) {
-	if (isLocalToFunction(I->first, i->first))
-	  dst.erase(I++);
-	else
-	  ++I;
+    const Callgraph::SCCList &SCCs = CG.getSCCs();
+
+    for (unsigned s = 0; s < SCCs.size(); ++s) {
+      const Callgraph::SCC &scc = SCCs[s];
+
+      if (!CG.isRecursive(s)) {
+	const Function *f = scc.front();
+	ModSet &M = own[f];
+
+	Callgraph::range_iterator R = CG.directCalls(f);
+	for (Callgraph::const_iterator I = R.first; I != R.second; ++I)
+	  addNonLocal(M, getModSet(I->second, MOD), f);
+
+	MOD[f] = MOD.intern(M);
+	continue;
       }
+
+      bool changed;
+      do {
+	changed = false;
+	for (Callgraph::SCC::const_iterator F = scc.begin(), FE = scc.end();
+	     F != FE; ++F) {
+	  ModSet &M = own[*F];
+
+	  Callgraph::range_iterator R = CG.directCalls(*F);
+	  for (Callgraph::const_iterator I = R.first; I != R.second; ++I) {
+	    const Function *g = I->second;
+	    if (g == *F)
+	      continue;
+	    if (CG.getSCCIndex(g) == s)
+	      changed |= addNonLocal(M, own[g], *F);
+	    else
+	      changed |= addNonLocal(M, getModSet(g, MOD), *F);
+	  }
+	}
+      } while (changed);
+
+      for (Callgraph::SCC::const_iterator F = scc.begin(), FE = scc.end();
+	   F != FE; ++F)
+	MOD[*F] = MOD.intern(own[*F]);
     }
 
 #ifdef DEBUG_DUMP
     errs() << "\n==== MODSET DUMP ====\n";
     for (ProgramStructure::const_iterator f = P.begin(); f != P.end(); ++f) {
 	const Function *fun = f->first;
-	const Modifies::ModSet &m = MOD[fun];
+	const Modifies::ModSet &m = getModSet(fun, MOD);
 
 	errs() << fun->getName() << "\n";
 	for (Modifies::ModSet::const_iterator I = m.begin(), E = m.end(); I != E; ++I) {
@@ -6,6 +6,7 @@
 
 #include <map>
 #include <set>
+#include <unordered_set>
 #include <vector>
 
 #include "llvm/Function.h"
@@ -19,7 +20,8 @@ namespace llvm { namespace mods {
 
     struct Modifies {
         typedef std::set<llvm::ptr::PointsToSets::Pointee> ModSet;
-        typedef std::map<const llvm::Function *, ModSet> Container;
+        // mod-sets are immutable once computed, equal ones are shared
+        typedef std::map<const llvm::Function *, const ModSet *> Container;
         typedef typename Container::key_type key_type;
         typedef typename Container::mapped_type mapped_type;
         typedef typename Container::value_type value_type;
@@ -27,6 +29,7 @@ namespace llvm { namespace mods {
         typedef typename Container::const_iterator const_iterator;
         typedef std::pair<iterator, bool> insert_retval;
 
+        Modifies() {}
         virtual ~Modifies() {}
 
         insert_retval insert(value_type const& val) { return C.insert(val); }
@@ -39,8 +42,28 @@ namespace llvm { namespace mods {
         iterator end() { return C.end(); }
         Container const& getContainer() const { return C; }
         Container& getContainer() { return C; }
+
+        // the shared copy of S, owned by this
+        const ModSet *intern(ModSet const& S) { return &*Sets.insert(S).first; }
+        unsigned getNumSets() const { return Sets.size(); }
     private:
+        struct ModSetHash {
+            size_t operator()(ModSet const& S) const {
+                std::hash<llvm::ptr::PointsToSets::Pointee> H;
+                size_t h = S.size();
+                for (ModSet::const_iterator I = S.begin(), E = S.end();
+                     I != E; ++I)
+                    h = h * 31 + H(*I);
+                return h;
+            }
+        };
+
+        // C points into Sets
+        Modifies(Modifies const&);
+        Modifies& operator=(Modifies const&);
+
         Container C;
+        std::unordered_set<ModSet, ModSetHash> Sets;
     };
 
     const Modifies::ModSet &getModSet(const llvm::Function *const &f,
@@ -1,6 +1,7 @@
 // This file is distributed under the University of Illinois Open Source
 // License. See LICENSE.TXT for details.
 
+#include <atomic>
 #include <map>
 #include <unordered_map>
 
@@ -10,22 +11,71 @@
 #include "llvm/Instruction.h"
 #include "llvm/Instructions.h"
 #include "llvm/Module.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/MutexGuard.h"
+#include "llvm/Support/RWMutex.h"
 
 #include "PointsTo.h"
 #include "RuleExpressions.h"
 
 #include "../Languages/LLVM.h"
+#include "../Support/Parallel.h"
+#include "../Support/Stats.h"
+#include "../Support/Trace.h"
+
+static llvm::cl::opt<unsigned>
+PTAThreads("pta-threads",
+           llvm::cl::desc("Number of threads computing the points-to "
+                          "categories in parallel"),
+           llvm::cl::init(1));
+
+static llvm::cl::opt<bool>
+PTAAddressTakenOnly("pta-address-taken-only",
+                    llvm::cl::desc("Indirect calls can call only functions "
+                                   "whose address is taken"));
+
+/* names of RuleCodeType values, in the order of the enum */
+static const char *const RuleTypeNames[] = {
+  "unknown", "var=alloc", "var=null", "var=var", "var=gep", "var=&var",
+  "var=*var", "*var=null", "*var=var", "*var=&var", "*var=*var", "dealloc"
+};
+
+static stats::KeyedCounter RuleApplicationsByType("pta.rule-applications",
+    "Rules applied, by kind of rule", RuleTypeNames,
+    sizeof(RuleTypeNames) / sizeof(*RuleTypeNames));
+static stats::Counter NodeMerges("pta.merges",
+    "Points-to graph nodes merged");
+static stats::Histogram SetSizes("pta.set-size",
+    "Sizes of the resulting points-to sets");
+static stats::Counter LookupMisses("pta.lookup-misses",
+    "Pointers queried with no points-to set");
 
 namespace llvm { namespace ptr { namespace detail {
 
+/*
+ * Candidate callees of indirect calls and callers of returns. Functions and
+ * indirect calls are indexed by their normalised signature (pointer
+ * parameters are alike, see compatibleTypes, the return type is exact as
+ * with the return type maps), so that a call looks only at the
+ * functions it can call. Vararg signatures are compatible with many
+ * others; they are looked up by the return type only, and that index is
+ * built on first use.
+ */
 class CallMaps {
 private:
-  /* return type -> function */
+  typedef std::vector<const Function *> Functions;
+  typedef std::vector<const CallInst *> Calls;
+  /* signature hash -> non-vararg functions/indirect calls */
+  typedef std::unordered_map<std::size_t, Functions> FunctionsIndex;
+  typedef std::unordered_map<std::size_t, Calls> CallsIndex;
+  /* return type -> function/call */
   typedef std::multimap<const Type *, const Function *> FunctionsMap;
   typedef std::multimap<const Type *, const CallInst *> CallsMap;
 
 public:
-  CallMaps(const Module &M) {
+  CallMaps(const Module &M) : builtRetMaps(false) {
     buildCallMaps(M);
   }
 
@@ -40,14 +90,30 @@ public:
   void collectReturnRuleCodes(const ReturnInst *r, OutIterator out);
 
 private:
+  FunctionsIndex funsBySig;
+  Functions varArgFuns;
+  CallsIndex callsBySig;
+  Calls varArgCalls;
+  std::map<const Function *, Calls> directCalls;
+
+  /* the whole-module maps for vararg lookups, see buildRetMaps */
+  bool builtRetMaps;
+  Functions allFuns;
+  Calls allCalls;
   FunctionsMap FM;
   CallsMap CM;
 
   static bool compatibleTypes(const Type *t1, const Type *t2);
   static bool compatibleFunTypes(const FunctionType *f1,
       const FunctionType *f2);
+  static bool isCandidate(const FunctionType *call,
+      const FunctionType *fun);
+  static std::size_t signatureHash(const FunctionType *funTy);
   static RuleCode argPassRuleCode(const Value *l, const Value *r);
+  void addFunction(const Function *f);
+  void addCall(const CallInst *c);
   void buildCallMaps(const Module &M);
+  void buildRetMaps();
 };
 
 RuleCode CallMaps::argPassRuleCode(const Value *l, const Value *r)
@@ -125,6 +191,31 @@ bool CallMaps::compatibleFunTypes(const FunctionType *f1,
   return true;
 }
 
+/*
+ * Can a call of type call reach a function of type fun? The return types
+ * have to be the same, even for pointers, the parameters only compatible.
+ */
+bool CallMaps::isCandidate(const FunctionType *call,
+    const FunctionType *fun) {
+  return call->getReturnType() == fun->getReturnType() &&
+    compatibleFunTypes(call, fun);
+}
+
+/*
+ * Equal for non-vararg types which isCandidate accepts. It has to ignore
+ * pointee types of the parameters for that, not of the return type.
+ */
+std::size_t CallMaps::signatureHash(const FunctionType *funTy) {
+  std::hash<const Type *> typeHash;
+  std::size_t h = funTy->getNumParams();
+
+  for (FunctionType::param_iterator I = funTy->param_begin(),
+       E = funTy->param_end(); I != E; ++I)
+    h = h * 31 + ((*I)->isPointerTy() ? 0 : typeHash(*I));
+
+  return h * 31 + typeHash(funTy->getReturnType());
+}
+
 template<typename OutIterator>
 void CallMaps::collectCallRuleCodes(const CallInst *c, OutIterator out) {
 
@@ -134,15 +225,30 @@ void CallMaps::collectCallRuleCodes(const CallInst *c, OutIterator out) {
     }
 
     const FunctionType *funTy = getCalleePrototype(c);
-    const Type *retTy = funTy->getReturnType();
 
-    for (FunctionsMap::const_iterator I = FM.lower_bound(retTy),
-	E = FM.upper_bound(retTy); I != E; ++I) {
-      const Function *fun = I->second;
+    if (funTy->isVarArg()) {
+      buildRetMaps();
 
-      if (compatibleFunTypes(funTy, fun->getFunctionType()))
-	collectCallRuleCodes(c, fun, out);
+      const Type *retTy = funTy->getReturnType();
+      for (FunctionsMap::const_iterator I = FM.lower_bound(retTy),
+	  E = FM.upper_bound(retTy); I != E; ++I)
+	if (compatibleFunTypes(funTy, I->second->getFunctionType()))
+	  collectCallRuleCodes(c, I->second, out);
+      return;
     }
+
+    /* the hash can collide, so check the types still */
+    FunctionsIndex::const_iterator I = funsBySig.find(signatureHash(funTy));
+    if (I != funsBySig.end())
+      for (Functions::const_iterator F = I->second.begin(),
+	  E = I->second.end(); F != E; ++F)
+	if (isCandidate(funTy, (*F)->getFunctionType()))
+	  collectCallRuleCodes(c, *F, out);
+
+    for (Functions::const_iterator F = varArgFuns.begin(),
+	E = varArgFuns.end(); F != E; ++F)
+      if (isCandidate(funTy, (*F)->getFunctionType()))
+	collectCallRuleCodes(c, *F, out);
 }
 
 template<typename OutIterator>
@@ -154,55 +260,428 @@ void CallMaps::collectReturnRuleCodes(const ReturnInst *r, OutIterator out) {
 
   const Function *f = r->getParent()->getParent();
   const FunctionType *funTy = f->getFunctionType();
-  const Type *retTy = funTy->getReturnType();
 
-  for (CallsMap::const_iterator b = CM.lower_bound(retTy),
-      e = CM.upper_bound(retTy); b != e; ++b) {
-    const CallInst *CI = b->second;
+  std::map<const Function *, Calls>::const_iterator D = directCalls.find(f);
+  if (D != directCalls.end())
+    for (Calls::const_iterator C = D->second.begin(), E = D->second.end();
+	C != E; ++C)
+      *out++ = argPassRuleCode(*C, retVal);
+
+  /* can indirect calls get here at all? */
+  if (PTAAddressTakenOnly && !f->hasAddressTaken())
+    return;
+
+  if (funTy->isVarArg()) {
+    buildRetMaps();
 
-    if (const Function *g = CI->getCalledFunction()) {
-      if (f == g)
-	*out++ = argPassRuleCode(CI, retVal);
-    } else if (compatibleFunTypes(funTy, getCalleePrototype(CI)))
-	*out++ = argPassRuleCode(CI, retVal);
+    const Type *retTy = funTy->getReturnType();
+    for (CallsMap::const_iterator b = CM.lower_bound(retTy),
+	e = CM.upper_bound(retTy); b != e; ++b)
+      if (compatibleFunTypes(funTy, getCalleePrototype(b->second)))
+	*out++ = argPassRuleCode(b->second, retVal);
+    return;
   }
+
+  CallsIndex::const_iterator I = callsBySig.find(signatureHash(funTy));
+  if (I != callsBySig.end())
+    for (Calls::const_iterator C = I->second.begin(), E = I->second.end();
+	C != E; ++C)
+      if (isCandidate(getCalleePrototype(*C), funTy))
+	*out++ = argPassRuleCode(*C, retVal);
+
+  for (Calls::const_iterator C = varArgCalls.begin(), E = varArgCalls.end();
+      C != E; ++C)
+    if (isCandidate(getCalleePrototype(*C), funTy))
+      *out++ = argPassRuleCode(*C, retVal);
+}
+
+/* a possible target of indirect calls */
+void CallMaps::addFunction(const Function *f) {
+  if (PTAAddressTakenOnly && !f->hasAddressTaken())
+    return;
+
+  const FunctionType *funTy = f->getFunctionType();
+
+  allFuns.push_back(f);
+  if (funTy->isVarArg())
+    varArgFuns.push_back(f);
+  else
+    funsBySig[signatureHash(funTy)].push_back(f);
+}
+
+void CallMaps::addCall(const CallInst *c) {
+  if (const Function *g = c->getCalledFunction()) {
+    directCalls[g].push_back(c);
+    return;
+  }
+
+  const FunctionType *funTy = getCalleePrototype(c);
+
+  allCalls.push_back(c);
+  if (funTy->isVarArg())
+    varArgCalls.push_back(c);
+  else
+    callsBySig[signatureHash(funTy)].push_back(c);
 }
 
 void CallMaps::buildCallMaps(const Module &M) {
     for (Module::const_iterator f = M.begin(); f != M.end(); ++f) {
-	if (!f->isDeclaration()) {
-	    const FunctionType *funTy = f->getFunctionType();
-
-	    FM.insert(std::make_pair(funTy->getReturnType(), &*f));
-	}
+	if (!f->isDeclaration())
+	    addFunction(&*f);
 
 	for (const_inst_iterator i = inst_begin(f), E = inst_end(f);
 		i != E; ++i) {
 	    if (const CallInst *CI = dyn_cast<CallInst>(&*i)) {
-		if (!isInlineAssembly(CI) && !callToMemoryManStuff(CI)) {
-		    const FunctionType *funTy = getCalleePrototype(CI);
-
-		    CM.insert(std::make_pair(funTy->getReturnType(), CI));
-		}
+		if (!isInlineAssembly(CI) && !callToMemoryManStuff(CI))
+		    addCall(CI);
 	    } else if (const StoreInst *SI = dyn_cast<StoreInst>(&*i)) {
 		const Value *r = SI->getValueOperand();
 
-		if (hasExtraReference(r) && memoryManStuff(r)) {
-		    const Function *fn = dyn_cast<Function>(r);
-		    const FunctionType *funTy = fn->getFunctionType();
-
-		    FM.insert(std::make_pair(funTy->getReturnType(), fn));
-		}
+		if (hasExtraReference(r) && memoryManStuff(r))
+		    addFunction(dyn_cast<Function>(r));
 	    }
 	}
     }
 }
 
+void CallMaps::buildRetMaps() {
+    if (builtRetMaps)
+	return;
+
+    for (Functions::const_iterator F = allFuns.begin(), E = allFuns.end();
+	    F != E; ++F)
+	FM.insert(std::make_pair((*F)->getFunctionType()->getReturnType(), *F));
+    for (Calls::const_iterator C = allCalls.begin(), E = allCalls.end();
+	    C != E; ++C)
+	CM.insert(std::make_pair(getCalleePrototype(*C)->getReturnType(), *C));
+
+    builtRetMaps = true;
+}
+
 }}}
 
 namespace llvm {
 namespace ptr {
 
+namespace {
+    // Values are stored in fixed-size chunks which never move. Readers
+    // can then translate IDs without taking the lock while other threads
+    // intern new values.
+    static const unsigned POINTEE_CHUNK_BITS = 16;
+    static const unsigned POINTEE_CHUNK_SIZE = 1 << POINTEE_CHUNK_BITS;
+    static const unsigned POINTEE_CHUNKS = 1 << (32 - POINTEE_CHUNK_BITS);
+
+    template<typename T, typename MapTy>
+    struct InternTable {
+        MapTy IDs;
+        T *Chunks[POINTEE_CHUNKS];
+        std::atomic<unsigned> Size;
+        llvm::sys::RWMutex Lock;
+
+        InternTable() : Chunks(), Size(0) {}
+
+        // does not intern, so lookups of known values share the lock
+        bool lookup(const T &V, unsigned &ID)
+        {
+            sys::ScopedReader Guard(Lock);
+
+            typename MapTy::const_iterator I = IDs.find(V);
+            if (I == IDs.end())
+                return false;
+
+            ID = I->second;
+            return true;
+        }
+
+        unsigned getID(const T &V)
+        {
+            unsigned ID;
+            if (lookup(V, ID))
+                return ID;
+
+            sys::ScopedWriter Guard(Lock);
+
+            unsigned S = Size.load();
+            std::pair<typename MapTy::iterator, bool> R =
+                IDs.insert(typename MapTy::value_type(V, S));
+
+            if (R.second) {
+                unsigned Chunk = S >> POINTEE_CHUNK_BITS;
+
+                assert(Chunk < POINTEE_CHUNKS && "Too many interned values");
+                if (!Chunks[Chunk])
+                    Chunks[Chunk] = new T[POINTEE_CHUNK_SIZE];
+
+                Chunks[Chunk][S & (POINTEE_CHUNK_SIZE - 1)] = V;
+                Size.store(S + 1);
+            }
+
+            return R.first->second;
+        }
+
+        const T &get(unsigned I) const
+        {
+            assert(I < Size.load() && "Unknown interned ID");
+            return Chunks[I >> POINTEE_CHUNK_BITS][I & (POINTEE_CHUNK_SIZE - 1)];
+        }
+    };
+
+    typedef InternTable<PointeeIndex::Pointee,
+            std::unordered_map<PointeeIndex::Pointee, unsigned> > PointeeTable;
+    typedef InternTable<PointeeRange::Range,
+            std::map<PointeeRange::Range, unsigned> > RangeTable;
+
+    PointeeTable &getPointeeTable()
+    {
+        static PointeeTable Table;
+        return Table;
+    }
+
+    RangeTable &getRangeTable()
+    {
+        static RangeTable Table;
+        return Table;
+    }
+}
+
+PointeeIndex::ID PointeeIndex::getID(const Pointee &P)
+{
+    return getPointeeTable().getID(P);
+}
+
+bool PointeeIndex::lookup(const Pointee &P, ID &I)
+{
+    return getPointeeTable().lookup(P, I);
+}
+
+const PointeeIndex::Pointee &PointeeIndex::getPointee(ID I)
+{
+    return getPointeeTable().get(I);
+}
+
+std::size_t PointeeIndex::size()
+{
+    return getPointeeTable().Size.load();
+}
+
+int PointeeRange::encode(int lo, int hi)
+{
+    assert(lo >= 0 && lo < hi && "Invalid range");
+
+    if (hi == lo + 1)
+        return lo;
+
+    return -2 - (int) getRangeTable().getID(Range(lo, hi));
+}
+
+PointeeRange::Range PointeeRange::decode(int off)
+{
+    if (!isRange(off))
+        return Range(off, off + 1);
+
+    return getRangeTable().get(-2 - off);
+}
+
+bool PointeeRange::overlap(const Pointee &A, const Pointee &B)
+{
+    if (A.first != B.first)
+        return false;
+
+    if (A.second == B.second)
+        return true;
+
+    // the variable itself has nothing in common with its memory
+    if (A.second == -1 || B.second == -1)
+        return false;
+
+    Range RA = decode(A.second), RB = decode(B.second);
+
+    return RA.first < RB.second && RB.first < RA.second;
+}
+
+bool PointeeRange::covers(const Pointee &A, const Pointee &B)
+{
+    if (A.first != B.first)
+        return false;
+
+    if (A.second == B.second)
+        return true;
+
+    if (A.second == -1 || B.second == -1)
+        return false;
+
+    Range RA = decode(A.second), RB = decode(B.second);
+
+    return RA.first <= RB.first && RB.second <= RA.second;
+}
+
+namespace {
+    // Interned sets by their hash. The table is never destroyed, handles
+    // in static objects may be released after the exit handlers ran.
+    struct SharedSetTable {
+        std::unordered_multimap<std::size_t, void *> Sets;
+        llvm::sys::Mutex Lock;
+    };
+
+    SharedSetTable &getSharedSetTable()
+    {
+        static SharedSetTable *Table = new SharedSetTable;
+        return *Table;
+    }
+}
+
+const PointeeSet &SharedPointeeSet::getEmptySet()
+{
+    static const PointeeSet Empty;
+    return Empty;
+}
+
+SharedPointeeSet::Storage *SharedPointeeSet::intern(const PointeeSet &Set)
+{
+    if (Set.empty())
+        return 0;
+
+    SharedSetTable &T = getSharedSetTable();
+    std::size_t Hash = Set.hash();
+    MutexGuard Guard(T.Lock);
+
+    typedef std::unordered_multimap<std::size_t, void *>::iterator It;
+    std::pair<It, It> R = T.Sets.equal_range(Hash);
+    for (It I = R.first; I != R.second; ++I) {
+        Storage *S = static_cast<Storage *>(I->second);
+        if (S->Set == Set) {
+            // under the lock, so that it cannot be freed meanwhile
+            S->Refs.fetch_add(1, std::memory_order_relaxed);
+            return S;
+        }
+    }
+
+    Storage *S = new Storage(Set, Hash);
+    T.Sets.insert(std::make_pair(Hash, static_cast<void *>(S)));
+    return S;
+}
+
+void SharedPointeeSet::release(Storage *S)
+{
+    if (!S)
+        return;
+
+    // somebody else holds a reference, the set stays
+    unsigned R = S->Refs.load();
+    while (R > 1)
+        if (S->Refs.compare_exchange_weak(R, R - 1))
+            return;
+
+    // we might be the last, but intern() can still find it in the table
+    SharedSetTable &T = getSharedSetTable();
+    MutexGuard Guard(T.Lock);
+
+    if (S->Refs.fetch_sub(1) != 1)
+        return;
+
+    typedef std::unordered_multimap<std::size_t, void *>::iterator It;
+    std::pair<It, It> Rng = T.Sets.equal_range(S->Hash);
+    for (It I = Rng.first; I != Rng.second; ++I)
+        if (I->second == S) {
+            T.Sets.erase(I);
+            break;
+        }
+
+    delete S;
+}
+
+std::size_t SharedPointeeSet::getNumInterned()
+{
+    SharedSetTable &T = getSharedSetTable();
+    MutexGuard Guard(T.Lock);
+
+    return T.Sets.size();
+}
+
+bool SharedPointeeSet::insert(const value_type &P)
+{
+    if (count(P))
+        return false;
+
+    PointeeSet Set(get());
+    Set.insert(P);
+    return assign(intern(Set));
+}
+
+bool SharedPointeeSet::unionWith(const SharedPointeeSet &RHS)
+{
+    if (S == RHS.S || !RHS.S)
+        return false;
+
+    if (!S) {
+        *this = RHS;
+        return true;
+    }
+
+    PointeeSet Set(S->Set);
+    if (!Set.unionWith(RHS.S->Set))
+        return false;
+
+    return assign(intern(Set));
+}
+
+bool SharedPointeeSet::intersectWith(const SharedPointeeSet &RHS)
+{
+    if (S == RHS.S || !S)
+        return false;
+
+    if (!RHS.S)
+        return assign(0);
+
+    PointeeSet Set(S->Set);
+    if (!Set.intersectWith(RHS.S->Set))
+        return false;
+
+    return assign(intern(Set));
+}
+
+bool SharedPointeeSet::intersectWith(const SharedPointeeSet &RHS,
+                                     PointeeSetIntersections &Cache)
+{
+    if (S == RHS.S || !S)
+        return false;
+
+    if (!RHS.S)
+        return assign(0);
+
+    SharedPointeeSet Result = Cache.get(*this, RHS);
+    if (Result == *this)
+        return false;
+
+    *this = Result;
+    return true;
+}
+
+SharedPointeeSet PointeeSetIntersections::get(const SharedPointeeSet &A,
+                                              const SharedPointeeSet &B)
+{
+    // intersection is commutative
+    std::pair<const void *, const void *> Key(A.getIdentity(),
+                                              B.getIdentity());
+    if (Key.second < Key.first)
+        std::swap(Key.first, Key.second);
+
+    std::pair<ResultsTy::iterator, bool> R =
+        Results.insert(std::make_pair(Key, Entry()));
+    Entry &E = R.first->second;
+
+    if (!R.second) {
+        ++Hits;
+        return E.Result;
+    }
+
+    E.A = A;
+    E.B = B;
+    E.Result = A;
+    E.Result.intersectWith(B);
+
+    return E.Result;
+}
 
 // This is an implementation of Shapiro-Horwitz analysis
 //
@@ -212,14 +691,11 @@ namespace ptr {
 ///
 PointsToGraph::~PointsToGraph()
 {
-    std::unordered_map<Pointer, Node *>::iterator I, E;
-
-    for (I = Nodes.begin(), E = Nodes.end(); I != E; ++I) {
-        if (I->second) {
-            replaceNode(I->second, NULL);
-            delete I->second;
-        }
-    }
+    // the memory itself goes away with the Allocator, only release
+    // what the elements and references may have allocated outside
+    for (std::vector<Node *>::iterator I = AllNodes.begin(),
+         E = AllNodes.end(); I != E; ++I)
+        (*I)->~Node();
 
     // PointsToGraph adopts the category, since it must be
     // allocated on heap because of virtual functions
@@ -251,10 +727,16 @@ static void printPtrName(const PointsToGraph::Pointee p)
 
     if (p.second >= 0)
         errs() << " + " << p.second;
+    else if (PointeeRange::isRange(p.second)) {
+        PointeeRange::Range R = PointeeRange::decode(p.second);
+        errs() << " + [" << R.first << ", " << R.second << ")";
+    }
 }
 
 void PointsToGraph::Node::dump(void) const
 {
+    sortElements();
+
     ElementsTy::const_iterator Begin = Elements.begin();
 
     errs() << "[";
@@ -272,44 +754,30 @@ void PointsToGraph::Node::dump(void) const
 
 void PointsToGraph::dump(void) const
 {
-    std::unordered_map<Pointer, Node *>::const_iterator I, E;
+    std::vector<Node *>::const_iterator I, E;
 
     if (Nodes.empty()) {
         errs() << "PointsToGraph is empty\n";
         return;
     }
 
-    for(I = Nodes.begin(), E = Nodes.end(); I != E; ++I) {
-        if (!I->second)
+    for(I = AllNodes.begin(), E = AllNodes.end(); I != E; ++I) {
+        if (!(*I)->isRepresentative())
             continue;
 
-        I->second->dump();
+        (*I)->dump();
 
-        Node::EdgesTy Edges = I->second->getEdges();
-        for (unsigned int I = 0; I < Node::EDGES_NUM; ++I) {
-            if (!Edges[I])
+        for (unsigned int J = 0; J < Node::EDGES_NUM; ++J) {
+            Node *n = (*I)->getEdge(J);
+            if (!n)
                 continue;
 
             errs() << "    --> ";
-            Edges[I]->dump();
+            n->dump();
         }
     }
 }
 
-void PointsToGraph::replaceNode(PointsToGraph::Node *a,
-                                PointsToGraph::Node *b)
-{
-    assert(a && "a must not be NULL");
-
-    Node::ElementsTy& Elements = a->getElements();
-
-    for (Node::ElementsTy::iterator I = Elements.begin(), E = Elements.end();
-         I != E; ++I) {
-        Node *&n = Nodes[*I];
-        n = b;
-    }
-}
-
 inline PointsToGraph::Node *PointsToGraph::findNode(Pointee p) const
 {
     std::unordered_map<Pointer, Node *>::const_iterator I;
@@ -318,12 +786,20 @@ inline PointsToGraph::Node *PointsToGraph::findNode(Pointee p) const
     if (I == Nodes.end())
         return NULL;
     else
-        return I->second;
+        return I->second->find();
+}
+
+inline PointsToGraph::Node *PointsToGraph::createNode(Pointee p)
+{
+    Node *n = new (Allocator.Allocate<Node>()) Node(p, this);
+    AllNodes.push_back(n);
+
+    return n;
 }
 
 inline PointsToGraph::Node *PointsToGraph::addNode(Pointee p)
 {
-    Node *n = new Node(p, this);
+    Node *n = createNode(p);
     Nodes[p] = n;
 
     return n;
@@ -339,58 +815,52 @@ inline PointsToGraph::Node *PointsToGraph::getNode(Pointee P)
     Node *&n = Nodes[P];
 
     if (!n)
-        n = new Node(P, this);
+        n = createNode(P);
 
-    return n;
+    return n->find();
 }
 
-// XXX do in Node's member function?
-void PointsToGraph::replaceEdges(Node *a, Node *b)
+// Merging is a union by rank. The absorbed node is kept alive (and its
+// edges untouched), so nothing pointing to it has to be rewritten --
+// Nodes, edges and references are resolved through find() when used.
+// Only the smaller of the two element sets is copied.
+void PointsToGraph::mergeNodes(Node *a, Node *b)
 {
-    assert(a && "a must not be NULL");
-    assert(b && "b must not be NULL");
+    a = a->find();
+    b = b->find();
 
-    Node::ReferencesTy& References = b->getReferences();
-    Node::EdgesTy Edges = b->getEdges();
-
-    // change edges that points to b so that they will point to a
-    for (Node::ReferencesTy::iterator I = References.begin(),
-         E = References.end(); I != E; ++I) {
+    if (a == b)
+        return;
 
-         // delete edges that points to b
-         (*I)->removeNeighbour(b->getCategory());
-         // and add edges that points to a instead
-         (*I)->addNeighbour(a);
-    }
+    if (a->Rank < b->Rank)
+        std::swap(a, b);
+    else if (a->Rank == b->Rank)
+        ++a->Rank;
 
-    // change references of outgoing edges
-    for (unsigned int I = 0; I < Node::EDGES_NUM; ++I)
-        if (Edges[I]) {
-            Edges[I]->getReferences().erase(b);
-            a->addNeighbour(Edges[I]);
-        }
-}
+    b->Parent = a;
+    ++Merges;
+    ++NodeMerges;
 
-void PointsToGraph::mergeNodes(Node *a, Node *b)
-{
-    Node::ElementsTy& ElementsB = b->getElements();
-
-    // copy elements from b to a
-    for (Node::ElementsTy::iterator I = ElementsB.begin(), E = ElementsB.end();
-         I != E; ++I) {
-        a->insert(*I);
+    // move elements of b to a
+    a->takeElements(b);
 
-        // set new location node for the element
-        Nodes[*I] = a;
-    }
+    // rules reading b read a from now on
+    Node::RulesTy& RulesB = b->getRules();
+    a->getRules().append(RulesB.begin(), RulesB.end());
+    RulesB.clear();
 
-    // make all nodes that point to b point to a
-    replaceEdges(a, b);
+    // nodes pointing to b point to a now (through find())
+    Node::ReferencesTy& ReferencesB = b->getReferences();
+    a->getReferences().insert(ReferencesB.begin(), ReferencesB.end());
+    ReferencesB.clear();
 
-    delete b;
+    nodeChanged(a);
 
-    // if there were some edges with the same category, then these should
-    // be merged in addNeighbour called from replaceEdges, so we're done here
+    // outgoing edges of b; the ones with the same category as some
+    // edge of a are merged in addNeighbour
+    for (unsigned int I = 0; I < Node::EDGES_NUM; ++I)
+        if (b->Edges[I])
+            a->addNeighbour(b->Edges[I]);
 }
 
 bool PointsToGraph::insert(Pointer p, Pointee location)
@@ -411,11 +881,12 @@ bool PointsToGraph::insert(Pointer p, Pointee location)
         // pointer is not in any node. Check if From node
         // has neighbour with the same category. If so, just
         // add the pointer there
-        Node *n = From->getEdges()[PTC->getCategory(location)]; 
+        Node *n = From->getEdge(PTC->getCategory(location));
 
         if (n) {
             n->insert(location);
             Nodes[location] = n;
+            nodeChanged(n);
             changed = true;
         } else {
             To = getNode(location);
@@ -441,11 +912,9 @@ bool PointsToGraph::insertDerefPointee(Node *PointerNode, Node *LocationNode)
 {
     bool changed = false;
 
-    Node::EdgesTy Edges = LocationNode->getEdges();
-
     for (unsigned int I = 0; I < Node::EDGES_NUM; ++I)
-        if (Edges[I])
-            changed |= PointerNode->addNeighbour(Edges[I]);
+        if (Node *n = LocationNode->getEdge(I))
+            changed |= PointerNode->addNeighbour(n);
 
     return changed;
 }
@@ -480,11 +949,9 @@ bool PointsToGraph::insertDerefPointer(Node *PointerNode, Node *LocationNode)
 {
     bool changed = false;
 
-    Node::EdgesTy Edges = PointerNode->getEdges();
-
     for (unsigned int I = 0; I < Node::EDGES_NUM; ++I)
-        if (Edges[I])
-            changed |= Edges[I]->addNeighbour(LocationNode);
+        if (Node *n = PointerNode->getEdge(I))
+            changed |= n->addNeighbour(LocationNode);
 
     return changed;
 }
@@ -515,68 +982,68 @@ bool PointsToGraph::insertDerefBoth(Node *PointerNode, Node *LocationNode)
 {
     bool changed = false;
 
-    Node::EdgesTy Edges = PointerNode->getEdges();
-
     for (unsigned int I = 0; I < Node::EDGES_NUM; ++I)
-        if (Edges[I])
-            changed |= insertDerefPointee(Edges[I], LocationNode);
+        if (Node *n = PointerNode->getEdge(I))
+            changed |= insertDerefPointee(n, LocationNode->find());
 
     return changed;
 }
 
 void PointsToGraph::Node::convertToPointsToSets(PointsToSets& PS,
+                                                PointeeSetIntersections &Cache,
                                                 bool intersect) const
 {
     typedef PointsToSets::PointsToSet PTSet;
-    typedef PointsToSets::Pointer Ptr;
+
+    // every element of this node points to the same locations,
+    // so build the union of the neighbours only once and share it
+    PointeeSet Targets;
+
+    for (unsigned int I = 0; I < EDGES_NUM; ++I) {
+        const Node *n = getEdge(I);
+        if (!n)
+            continue;
+
+        const ElementsTy& Ptees = n->getElements();
+        for (ElementsTy::const_iterator PI = Ptees.begin(), PE = Ptees.end();
+             PI != PE; ++PI)
+            Targets.insert(*PI);
+    }
+
+    const PTSet Shared(Targets);
 
     for (ElementsTy::const_iterator ElemI = Elements.begin(),
          ElemE = Elements.end();
          ElemI != ElemE; ++ElemI) {
 
-        PTSet& S = PS[*ElemI];
-        PTSet TmpPTSet;
+        if (intersect) {
+            PointsToSets::iterator SI = PS.find(*ElemI);
 
-        for (unsigned int I = 0; I < EDGES_NUM; ++I) {
-            if (!Edges[I])
+            // nothing to intersect with, the pointer was dropped before
+            if (SI == PS.end())
                 continue;
 
-            const ElementsTy& Ptees = Edges[I]->getElements();
-
-            if (intersect) {
-                // when creating intersection, add the intersection into
-                // TmpPTSet (if there are more outgoing edges from a node,
-                // then I need to accumulate intersections from all these nodes
-                std::set_intersection(S.begin(), S.end(),
-                                      Ptees.begin(), Ptees.end(),
-                                      std::inserter(TmpPTSet, TmpPTSet.end()));
-
-            } else {
-                std::copy(Ptees.begin(), Ptees.end(),
-                          std::inserter(S, S.end()));
-            }
-        }
-
-        if (intersect) {
-            // store accumulated intersection in original pt set
-            S.swap(TmpPTSet);
+            SI->second.intersectWith(Shared, Cache);
 
             // clean empty nodes. Empty nodes can be created only by
             // intersection
-            if (S.empty())
-                PS.getContainer().erase(PS.find(*ElemI));
+            if (SI->second.empty())
+                PS.getContainer().erase(SI);
+        } else {
+            PS[*ElemI].unionWith(Shared);
         }
     }
 }
 
 PointsToSets& PointsToGraph::toPointsToSets(PointsToSets& PS) const
 {
-    std::unordered_map<Pointer, Node *>::const_iterator I, E;
+    std::vector<Node *>::const_iterator I, E;
     bool intersect = !PS.getContainer().empty();
+    PointeeSetIntersections Cache;
 
-    for (I = Nodes.cbegin(), E = Nodes.cend(); I != E; ++I)
-        if (I->second && (I->second)->hasNeighbours())
-            (I->second)->convertToPointsToSets(PS, intersect);
+    for (I = AllNodes.begin(), E = AllNodes.end(); I != E; ++I)
+        if ((*I)->isRepresentative() && (*I)->hasNeighbours())
+            (*I)->convertToPointsToSets(PS, Cache, intersect);
 
     return PS;
 }
@@ -600,7 +1067,7 @@ bool PointsToGraph::applyRule(ASSIGNMENT<
     return insertDerefPointee(Ptr(lval, -1), Ptr(rval, -1));
 }
 
-static int64_t accumulateConstantOffset(const GetElementPtrInst *gep,
+int64_t accumulateConstantOffset(const GetElementPtrInst *gep,
 	const DataLayout &DL, bool &isArray) {
     int64_t off = 0;
 
@@ -633,18 +1100,29 @@ static int64_t accumulateConstantOffset(const GetElementPtrInst *gep,
     return off;
 }
 
-static bool checkOffset(const DataLayout &DL, const Value *Rval, uint64_t sum) {
-  if (const GlobalVariable *GV = dyn_cast<GlobalVariable>(Rval)) {
-    if (GV->hasInitializer() &&
-	sum >= DL.getTypeAllocSize(GV->getInitializer()->getType()))
-      return false;
-  } else if (const AllocaInst *AI = dyn_cast<AllocaInst>(Rval)) {
-    if (!AI->isArrayAllocation() &&
-	sum >= DL.getTypeAllocSize(AI->getAllocatedType()))
-      return false;
+// no sane structure is larger
+static const int64_t MAX_GEP_OFFSET = 1 << 20;
+
+bool getAllocatedSize(const DataLayout &DL, const Value *V, uint64_t &size) {
+  if (const GlobalVariable *GV = dyn_cast<GlobalVariable>(V)) {
+    if (GV->hasInitializer()) {
+      size = DL.getTypeAllocSize(GV->getInitializer()->getType());
+      return true;
+    }
+  } else if (const AllocaInst *AI = dyn_cast<AllocaInst>(V)) {
+    if (!AI->isArrayAllocation()) {
+      size = DL.getTypeAllocSize(AI->getAllocatedType());
+      return true;
+    }
   }
 
-  return true;
+  return false;
+}
+
+static bool checkOffset(const DataLayout &DL, const Value *Rval, uint64_t sum) {
+  uint64_t size;
+
+  return !getAllocatedSize(DL, Rval, size) || sum < size;
 }
 
 bool PointsToGraph::applyRule(const llvm::DataLayout &DL,
@@ -673,15 +1151,15 @@ bool PointsToGraph::applyRule(const llvm::DataLayout &DL,
         if (!n || !n->hasNeighbours())
             return false;
 
-        Node::EdgesTy Edges = n->getEdges();
         for (unsigned int I = 0; I < Node::EDGES_NUM; ++I) {
-            if (!Edges[I])
+            Node *e = n->getEdge(I);
+            if (!e)
                 continue;
 
             // if it's an array, go backward and find last offset
             // (set is sorted). It can introduce some unsoundness,
             // but for most cases it's working pretty well
-            Node::ElementsTy& Elems = Edges[I]->getElements();
+            Node::ElementsTy& Elems = e->getElements();
             Node::ElementsTy::reverse_iterator PI, PE;
             for (PI = Elems.rbegin(), PE = Elems.rend(); PI != PE; ++PI) {
 
@@ -703,6 +1181,10 @@ bool PointsToGraph::applyRule(const llvm::DataLayout &DL,
                     /* unsoundnes :-) */
                     else if (sum > 64)
                         sum = 64;
+                } else if (sum > MAX_GEP_OFFSET) {
+                    // a cycle of GEPs over casted memory would grow
+                    // the offset forever now that we iterate to a fixpoint
+                    continue;
                 }
 
                 if (!checkOffset(DL, val, sum))
@@ -743,11 +1225,10 @@ bool PointsToGraph::applyRule(ASSIGNMENT<
     if (!r)
         return false;
 
-    Node::EdgesTy Edges = r->getEdges();
     for (unsigned int I = 0; I < Node::EDGES_NUM; ++I)
-        if (Edges[I])
+        if (Node *n = r->getEdge(I))
             // must process nodes *two* steps away
-            change |= insertDerefPointee(L, Edges[I]);
+            change |= insertDerefPointee(L, n);
 
     return change;
 }
@@ -808,10 +1289,11 @@ bool PointsToGraph::applyRule(ASSIGNMENT<
     // but we need to iterate only over these (old) edges
     // XXX don't we need copying even when dereferencing only one side??
     Node *Edges[NODE_EDGES_NUM];
-    memcpy(&Edges, r->getEdges(), sizeof Edges);
+    for (unsigned int I = 0; I < Node::EDGES_NUM; ++I)
+        Edges[I] = r->getEdge(I);
     for (unsigned int I = 0; I < Node::EDGES_NUM; ++I)
         if (Edges[I])
-            change |= insertDerefBoth(l, Edges[I]);
+            change |= insertDerefBoth(l->find(), Edges[I]);
 
     return change;
 }
@@ -942,21 +1424,224 @@ static PointsToSets &pruneByType(PointsToSets &S) {
   return S;
 }
 
+void PointsToGraph::buildRuleDeps(void)
+{
+    const ProgramStructure::Container& Rules = PS->getContainer();
+
+    for (unsigned I = 0; I < Rules.size(); ++I) {
+        const RuleCode &RC = Rules[I];
+        const llvm::Value *lval = RC.getLvalue();
+        const llvm::Value *rval = RC.getRvalue();
+
+        switch (RC.getType()) {
+        // these only add an edge, they do not read anything
+        case RCT_VAR_ASGN_ALLOC:
+        case RCT_VAR_ASGN_NULL:
+        case RCT_VAR_ASGN_REF_VAR:
+        case RCT_DEALLOC:
+            break;
+        case RCT_VAR_ASGN_GEP: {
+            const GetElementPtrInst *gep = dyn_cast<GetElementPtrInst>(rval);
+            const llvm::Value *op = elimConstExpr(gep->getPointerOperand());
+
+            if (!hasExtraReference(op))
+                RuleDeps[Ptr(op, -1)].push_back(I);
+            break;
+        }
+        case RCT_VAR_ASGN_VAR:
+        case RCT_VAR_ASGN_DREF_VAR:
+            RuleDeps[Ptr(rval, -1)].push_back(I);
+            break;
+        case RCT_DREF_VAR_ASGN_NULL:
+        case RCT_DREF_VAR_ASGN_REF_VAR:
+            RuleDeps[Ptr(lval, -1)].push_back(I);
+            break;
+        case RCT_DREF_VAR_ASGN_VAR:
+        case RCT_DREF_VAR_ASGN_DREF_VAR:
+            RuleDeps[Ptr(lval, -1)].push_back(I);
+            if (lval != rval)
+                RuleDeps[Ptr(rval, -1)].push_back(I);
+            break;
+        default:
+            assert(0 && "Unknown rule code");
+        }
+    }
+}
+
+void PointsToGraph::getRuleDeps(Pointer p, Node::RulesTy& Rules) const
+{
+    std::unordered_map<Pointer, Node::RulesTy>::const_iterator I;
+
+    I = RuleDeps.find(p);
+    if (I != RuleDeps.end())
+        Rules.append(I->second.begin(), I->second.end());
+}
+
+void PointsToGraph::schedule(const Node::RulesTy& Rules)
+{
+    for (Node::RulesTy::const_iterator I = Rules.begin(), E = Rules.end();
+         I != E; ++I) {
+        if (Scheduled[*I])
+            continue;
+
+        Scheduled[*I] = true;
+        Worklist.push_back(*I);
+    }
+}
+
+// Rules read edges of their operand nodes and edges (or elements) of nodes
+// one step further, so wake up rules of n and of all nodes pointing to n.
+void PointsToGraph::nodeChanged(Node *n)
+{
+    n = n->find();
+    schedule(n->getRules());
+
+    // references may have been merged meanwhile
+    Node::ReferencesTy& References = n->getReferences();
+    for (Node::ReferencesTy::iterator I = References.begin(),
+         E = References.end(); I != E; ++I)
+        schedule((*I)->find()->getRules());
+}
+
 const PointsToGraph& PointsToGraph::build(void)
 {
     DataLayout DL(&PS->getModule());
+    const ProgramStructure::Container& Rules = PS->getContainer();
 
-    for (ProgramStructure::const_iterator I = PS->begin(); I != PS->end(); ++I)
-        applyRules(*I, DL);
+    buildRuleDeps();
+
+    // the first sweep goes in program order, then only rules whose
+    // operand nodes changed are applied again until the fixpoint
+    for (unsigned I = 0; I < Rules.size(); ++I) {
+        Scheduled[I] = true;
+        Worklist.push_back(I);
+    }
+
+    while (!Worklist.empty()) {
+        unsigned I = Worklist.front();
+        Worklist.pop_front();
+        Scheduled[I] = false;
+
+        applyRules(Rules[I], DL);
+        ++RuleApplications;
+        RuleApplicationsByType.add(Rules[I].getType());
+    }
+
+#ifdef PS_DEBUG
+    errs() << "[Points-to]: " << RuleApplications << " rule applications for "
+           << Rules.size() << " rules\n";
+#endif // PS_DEBUG
 
     return *this;
 }
 
+// Intersect B into A. A pointer missing in one of the sets was not seen by
+// that run, so it keeps the set from the other one. This makes the operation
+// commutative and associative, so the runs can be reduced in any order.
+// Emptied sets are kept: an empty set absorbs whatever it meets later, just
+// as a pointer dropped by a serial run is never added back.
+static void intersectPointsToSets(PointsToSets &A, PointsToSets &B)
+{
+    PointsToSets::Container &CA = A.getContainer();
+    PointeeSetIntersections Cache;
+
+    for (PointsToSets::iterator I = B.begin(), E = B.end(); I != E; ++I) {
+        PointsToSets::iterator AI = A.find(I->first);
+
+        if (AI == A.end()) {
+            CA.insert(*I);
+            continue;
+        }
+
+        AI->second.intersectWith(I->second, Cache);
+    }
+}
+
+// Intersect the reduced runs R into S the way toPointsToSets would: only the
+// pointers of S are kept and the emptied ones are dropped.
+static void mergePointsToSets(PointsToSets &S, const PointsToSets &R)
+{
+    PointsToSets::Container &CS = S.getContainer();
+    PointeeSetIntersections Cache;
+
+    for (PointsToSets::iterator I = S.begin(), E = S.end(); I != E; ) {
+        PointsToSets::const_iterator RI = R.find(I->first);
+
+        if (RI != R.end())
+            I->second.intersectWith(RI->second, Cache);
+
+        if (I->second.empty())
+            CS.erase(I++);
+        else
+            ++I;
+    }
+}
+
+// Run categories [First, Runs) and intersect them into S.
+static void runCategories(const ProgramStructure &P, PointsToSets &S,
+                          unsigned int First, unsigned int Runs,
+                          unsigned int Threads)
+{
+    if (First >= Runs)
+        return;
+
+    if (Threads <= 1) {
+        for (unsigned int I = First; I < Runs; ++I) {
+            trace::Scope T("pta.category", utostr(I));
+            PointsToGraph PTG(&P, new IDBitsCategory(I));
+            PTG.toPointsToSets(S);
+        }
+        return;
+    }
+
+    // the runs share only the read-only ProgramStructure
+    std::vector<PointsToSets> Results(Runs - First);
+
+    parallel::parallelFor(Results.size(), Threads, [&](unsigned I) {
+        trace::Scope T("pta.category", utostr(First + I));
+        PointsToGraph PTG(&P, new IDBitsCategory(First + I));
+        PTG.toPointsToSets(Results[I]);
+    });
+
+    trace::Scope T("pta.intersect");
+
+    // like the serial loop, the first run decides which pointers there are
+    unsigned int Base = 0;
+    if (S.getContainer().empty()) {
+        S.getContainer().swap(Results[0].getContainer());
+        Base = 1;
+    }
+
+    // tree reduction of the rest, each level halves the number of sets
+    unsigned int Count = Results.size() - Base;
+    for (unsigned int Step = 1; Step < Count; Step *= 2) {
+        unsigned int Pairs = (Count + 2 * Step - 1) / (2 * Step);
+
+        parallel::parallelFor(Pairs, Threads, [&](unsigned I) {
+            unsigned int L = 2 * Step * I;
+            if (L + Step < Count)
+                intersectPointsToSets(Results[Base + L],
+                                      Results[Base + L + Step]);
+        });
+    }
+
+    if (Count)
+        mergePointsToSets(S, Results[Base]);
+}
+
+unsigned getResultOptions()
+{
+    return PTAAddressTakenOnly ? RESULT_ADDRESS_TAKEN_ONLY : 0;
+}
+
 PointsToSets &computePointsToSets(const ProgramStructure &P, PointsToSets &S,
-                                  unsigned int K)
+                                  unsigned int K, unsigned int Threads)
 {
-    PointsToSets TmpPTS;
-    unsigned int Runs, I;
+    trace::Scope Total("pta");
+    unsigned int Runs;
+
+    if (!Threads)
+        Threads = PTAThreads;
 
     if (K) {
         Runs = (unsigned int) (log(K) / log(2)); // transfer to base of 2
@@ -967,10 +1652,7 @@ PointsToSets &computePointsToSets(const ProgramStructure &P, PointsToSets &S,
         errs() << "[Points-to]: Running algorithm " << Runs << " times\n";
 #endif // PS_DEBUG
 
-        for (I = 0; I < Runs; ++I) {
-            PointsToGraph PTG(&P, new IDBitsCategory(I));
-            PTG.toPointsToSets(S);
-        }
+        runCategories(P, S, 0, Runs, Threads);
     // if K is not given, compute number of runs from first run
     // XXX or use program structure?
     } else {
@@ -978,8 +1660,11 @@ PointsToSets &computePointsToSets(const ProgramStructure &P, PointsToSets &S,
         // However, points-to sets computed by steengaard's analysis
         // gives us upper bound. They can be now only
         // reduced. Deduce next steps from this first run
-        PointsToGraph PTG(&P, new AllInOneCategory());
-        PTG.toPointsToSets(S);
+        {
+            trace::Scope T("pta.category", "all-in-one");
+            PointsToGraph PTG(&P, new AllInOneCategory());
+            PTG.toPointsToSets(S);
+        }
 
         K = S.getContainer().size();
         // use log2(n) runs of the algorithm
@@ -994,14 +1679,21 @@ PointsToSets &computePointsToSets(const ProgramStructure &P, PointsToSets &S,
         errs() << "[Points-to]: Running algorithm " << Runs << " times\n";
 #endif // PS_DEBUG
 
-        // I = 1 because we have already done one run
-        for (I = 1; I < Runs; ++I) {
-            PointsToGraph PTG(&P, new IDBitsCategory(I));
-            PTG.toPointsToSets(S);
-        }
+        // start at 1 because we have already done one run
+        runCategories(P, S, 1, Runs, Threads);
     }
 
-    return pruneByType(S);
+    {
+        trace::Scope T("pta.prune-by-type");
+        pruneByType(S);
+    }
+
+    if (stats::enabled())
+      for (PointsToSets::const_iterator I = S.begin(), E = S.end(); I != E;
+           ++I)
+        SetSizes.add(I->second.size());
+
+    return S;
 }
 
 const PTSet &
@@ -1010,15 +1702,23 @@ getPointsToSet(const llvm::Value *const &memLoc, const PointsToSets &S,
   const PointsToSets::const_iterator it = S.find(Ptr(memLoc, idx));
   if (it == S.end()) {
     static const PTSet emptySet;
-    errs() << "WARNING[PointsTo]: No points-to set has been found: ";
-    memLoc->print(errs());
-    errs() << '\n';
+    static std::atomic<unsigned> warned(0);
+
+    ++LookupMisses;
+    /* the rest is counted by -slicer-stats-json */
+    if (warned++ < 3) {
+      errs() << "WARNING[PointsTo]: No points-to set has been found: ";
+      memLoc->print(errs());
+      errs() << '\n';
+    }
     return emptySet;
   }
   return it->second;
 }
 
 ProgramStructure::ProgramStructure(Module &M) : M(M) {
+    trace::Scope T("pta.program-structure");
+
     for (Module::const_global_iterator g = M.global_begin(), E = M.global_end();
 	    g != E; ++g)
       if (isGlobalPointerInitialization(&*g))
@@ -4,6 +4,10 @@
 #ifndef POINTSTO_POINTSTO_H
 #define POINTSTO_POINTSTO_H
 
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <iterator>
 #include <map>
 #include <unordered_map>
 #include <set>
@@ -11,11 +15,271 @@
 
 #include "llvm/Value.h"
 #include "llvm/DataLayout.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/SparseBitVector.h"
+#include "llvm/Support/Allocator.h"
 
 #include "RuleExpressions.h"
 
+namespace std {
+
+typedef pair<const llvm::Value *, int> Ptr;
+
+template<>
+struct hash<Ptr> {
+    size_t operator()(const Ptr& val) const
+    {
+        return (_hash(val.first) ^ val.second);
+    }
+
+    hash<const llvm::Value *> _hash;
+};
+
+} // namespace std
+
 namespace llvm { namespace ptr {
 
+  ///
+  // Interns every <location, offset> pair into a dense 32-bit ID. The IDs
+  // are process-wide and never released, so they can be compared across
+  // different PointsToSets.
+  ///
+  class PointeeIndex {
+  public:
+    typedef std::pair<const llvm::Value *, int> Pointee;
+    typedef unsigned ID;
+
+    static ID getID(const Pointee &P);
+    // like getID, but false for a pointee which was never interned
+    static bool lookup(const Pointee &P, ID &I);
+    static const Pointee &getPointee(ID I);
+    static std::size_t size();
+  };
+
+  ///
+  // Byte ranges <loc, [lo,hi)> are pointees too, so that memcpy and memset
+  // are described by a single pointee instead of one per byte. Offsets
+  // >= 0 are single bytes and -1 is the variable itself; a range is
+  // interned and stored in the offset as -2 - ID.
+  ///
+  class PointeeRange {
+  public:
+    typedef PointeeIndex::Pointee Pointee;
+    typedef std::pair<int, int> Range; // [lo, hi)
+
+    // offset describing [lo, hi), a plain offset for one byte
+    static int encode(int lo, int hi);
+    static bool isRange(int off) { return off < -1; }
+    // byte range of the offset, [off, off + 1) for a single byte
+    static Range decode(int off);
+
+    // do the two pointees share some byte?
+    static bool overlap(const Pointee &A, const Pointee &B);
+    // is every byte of B in A?
+    static bool covers(const Pointee &A, const Pointee &B);
+  };
+
+  ///
+  // Set of pointees stored as a sparse bitvector of their IDs. Iterators
+  // yield Pointee pairs, ordered by ID.
+  ///
+  class PointeeSet {
+  public:
+    typedef PointeeIndex::Pointee value_type;
+    typedef llvm::SparseBitVector<> BitsTy;
+
+    class const_iterator :
+      public std::iterator<std::forward_iterator_tag, const value_type> {
+    public:
+      const_iterator() : I(getEmptyBits().end()) {}
+      explicit const_iterator(const BitsTy::iterator &I) : I(I) {}
+
+      const value_type &operator*() const
+        { return PointeeIndex::getPointee(*I); }
+      const value_type *operator->() const { return &operator*(); }
+
+      const_iterator &operator++() { ++I; return *this; }
+      const_iterator operator++(int)
+        { const_iterator tmp = *this; ++I; return tmp; }
+
+      bool operator==(const const_iterator &RHS) const { return I == RHS.I; }
+      bool operator!=(const const_iterator &RHS) const { return I != RHS.I; }
+    private:
+      BitsTy::iterator I;
+    };
+    typedef const_iterator iterator;
+
+    bool insert(const value_type &P) {
+      PointeeIndex::ID id = PointeeIndex::getID(P);
+      if (Bits.test(id))
+        return false;
+      Bits.set(id);
+      return true;
+    }
+    bool count(const value_type &P) const {
+      PointeeIndex::ID id;
+      return PointeeIndex::lookup(P, id) && Bits.test(id);
+    }
+
+    // return true if this set has changed
+    bool unionWith(const PointeeSet &RHS) { return Bits |= RHS.Bits; }
+    bool intersectWith(const PointeeSet &RHS) { return Bits &= RHS.Bits; }
+    bool intersects(const PointeeSet &RHS) const
+      { return Bits.intersects(RHS.Bits); }
+
+    bool empty() const { return Bits.empty(); }
+    std::size_t size() const { return Bits.count(); }
+    void clear() { Bits.clear(); }
+
+    const_iterator begin() const { return const_iterator(Bits.begin()); }
+    const_iterator end() const { return const_iterator(Bits.end()); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    bool operator==(const PointeeSet &RHS) const { return Bits == RHS.Bits; }
+    bool operator!=(const PointeeSet &RHS) const { return Bits != RHS.Bits; }
+
+    std::size_t hash() const {
+      std::size_t H = 0;
+      for (BitsTy::iterator I = Bits.begin(), E = Bits.end(); I != E; ++I)
+        H = H * 31 + *I;
+      return H;
+    }
+
+  private:
+    static const BitsTy &getEmptyBits() {
+      static const BitsTy empty;
+      return empty;
+    }
+
+    BitsTy Bits;
+  };
+
+  class PointeeSetIntersections;
+
+  ///
+  // Handle of an immutable PointeeSet interned in a process-wide table, so
+  // that pointers with equal sets share one copy and equal sets compare by
+  // address. Handles are reference counted, a modification makes the handle
+  // refer to another interned set (copy on write). The empty set is not
+  // interned.
+  ///
+  class SharedPointeeSet {
+  public:
+    typedef PointeeSet::value_type value_type;
+    typedef PointeeSet::const_iterator const_iterator;
+    typedef const_iterator iterator;
+
+    SharedPointeeSet() : S(0) {}
+    explicit SharedPointeeSet(const PointeeSet &Set) : S(intern(Set)) {}
+    SharedPointeeSet(const SharedPointeeSet &RHS) : S(RHS.S) { retain(S); }
+    ~SharedPointeeSet() { release(S); }
+
+    SharedPointeeSet &operator=(const SharedPointeeSet &RHS) {
+      retain(RHS.S);
+      release(S);
+      S = RHS.S;
+      return *this;
+    }
+
+    const PointeeSet &get() const { return S ? S->Set : getEmptySet(); }
+
+    // return true if this set has changed
+    //
+    // Every change copies the set and interns the copy. To add many
+    // pointees, insert the whole range, which interns only once.
+    bool insert(const value_type &P);
+    template<typename InputIt>
+    bool insert(InputIt First, InputIt Last) {
+      PointeeSet Set(get());
+      bool Changed = false;
+      for (; First != Last; ++First)
+        Changed |= Set.insert(*First);
+      return Changed && assign(intern(Set));
+    }
+    bool unionWith(const SharedPointeeSet &RHS);
+    bool intersectWith(const SharedPointeeSet &RHS);
+    bool intersectWith(const SharedPointeeSet &RHS,
+                       PointeeSetIntersections &Cache);
+
+    bool count(const value_type &P) const { return get().count(P); }
+    bool intersects(const SharedPointeeSet &RHS) const
+      { return S == RHS.S ? S != 0 : get().intersects(RHS.get()); }
+
+    bool empty() const { return !S; }
+    std::size_t size() const { return get().size(); }
+    void clear() { assign(0); }
+
+    const_iterator begin() const { return get().begin(); }
+    const_iterator end() const { return get().end(); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    bool operator==(const SharedPointeeSet &RHS) const { return S == RHS.S; }
+    bool operator!=(const SharedPointeeSet &RHS) const { return S != RHS.S; }
+
+    // the interned set, usable as a key while the handle lives
+    const void *getIdentity() const { return S; }
+
+    // number of distinct non-empty sets alive
+    static std::size_t getNumInterned();
+
+  private:
+    struct Storage {
+      Storage(const PointeeSet &Set, std::size_t Hash) :
+        Set(Set), Hash(Hash), Refs(1) {}
+
+      const PointeeSet Set;
+      const std::size_t Hash;
+      std::atomic<unsigned> Refs;
+    };
+
+    // the returned storage is retained already
+    static Storage *intern(const PointeeSet &Set);
+    static void retain(Storage *S) {
+      if (S)
+        S->Refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    static void release(Storage *S);
+    static const PointeeSet &getEmptySet();
+
+    // take over the reference to NS
+    bool assign(Storage *NS) {
+      bool Changed = NS != S;
+      release(S);
+      S = NS;
+      return Changed;
+    }
+
+    Storage *S;
+  };
+
+  ///
+  // Memoised intersections of pairs of shared sets. Equal pointers of
+  // different runs mostly have the same pairs, so each distinct pair is
+  // intersected only once. The cache keeps the operands alive, so their
+  // addresses cannot be reused while it exists.
+  ///
+  class PointeeSetIntersections {
+  public:
+    PointeeSetIntersections() : Hits(0) {}
+
+    SharedPointeeSet get(const SharedPointeeSet &A,
+                         const SharedPointeeSet &B);
+
+    unsigned getHits() const { return Hits; }
+    std::size_t size() const { return Results.size(); }
+
+  private:
+    struct Entry {
+      SharedPointeeSet A, B, Result;
+    };
+    typedef std::map<std::pair<const void *, const void *>, Entry> ResultsTy;
+
+    ResultsTy Results;
+    unsigned Hits;
+  };
+
   class PointsToSets {
   public:
     typedef const llvm::Value *MemoryLocation;
@@ -33,8 +297,8 @@ namespace llvm { namespace ptr {
      * can be only an alloc companied by an offset (we can point to the
      * middle).
      */
-    typedef std::pair<MemoryLocation, int> Pointee;
-    typedef std::set<Pointee> PointsToSet;
+    typedef PointeeIndex::Pointee Pointee;
+    typedef SharedPointeeSet PointsToSet;
 
     typedef std::map<Pointer, PointsToSet> Container;
     typedef Container::key_type key_type;
@@ -91,22 +355,6 @@ namespace llvm { namespace ptr {
 
 }}
 
-namespace std {
-
-typedef pair<const llvm::Value *, int> Ptr;
-
-template<>
-struct hash<Ptr> {
-    size_t operator()(const Ptr& val) const
-    {
-        return (_hash(val.first) ^ val.second);
-    }
-
-    hash<const llvm::Value *> _hash;
-};
-
-} // namespace std
-
 namespace llvm {
 namespace ptr {
 
@@ -156,10 +404,11 @@ namespace ptr {
     public:
         // will build the points-to graph right from the constructor
         PointsToGraph(const ProgramStructure *PS, PointsToCategories *PTC)
-        :PS(PS), PTC(PTC)
+        :Merges(0), PS(PS), PTC(PTC), RuleApplications(0)
         {
             // estimate number of pointers
             Nodes.reserve(3 * PS->getContainer().size() / 2);
+            Scheduled.resize(PS->getContainer().size());
             build();
         }
 
@@ -171,35 +420,103 @@ namespace ptr {
         PointsToSets& toPointsToSets(PointsToSets& PS) const;
         void dump(void) const;
 
+        // how many times was applyRules() called by build()
+        unsigned long getRuleApplications(void) const
+            { return RuleApplications; }
+        // how many times were two nodes merged
+        unsigned long getMerges(void) const
+            { return Merges; }
+
     private:
         // this class represents one node in the graph
+        //
+        // Merged nodes form a union-find forest. Only the representative
+        // (the root) holds valid elements, references and rules. Edges,
+        // references and the Nodes map may point to absorbed nodes and are
+        // resolved to the representative lazily.
+        //
+        // Nodes live in the graph's arena. Elements are a flat vector; every
+        // pointee is in exactly one node, so appending never duplicates and
+        // the vector is sorted lazily when read.
         class Node
         {
         public:
-            typedef std::set<Pointee> ElementsTy;
+            typedef llvm::SmallVector<Pointee, 4> ElementsTy;
             typedef llvm::SmallPtrSet<Node *, 16> ReferencesTy;
+            // indices of rules in ProgramStructure reading this node
+            typedef llvm::SmallVector<unsigned, 2> RulesTy;
 
-            typedef Node** EdgesTy;
             #define NODE_EDGES_NUM 8
             static const unsigned int EDGES_NUM = NODE_EDGES_NUM;
 
-            Node() {};
+            Node() : Sorted(0), Parent(this), Rank(0) {};
             Node(Pointee p, PointsToGraph *PTG)
-                :origin(p), PTG(PTG)
-                { insert(p); Category = PTG->getCategories()->getCategory(p); }
+                :Sorted(0), origin(p), PTG(PTG), Parent(this), Rank(0)
+            {
+                insert(p);
+                Category = PTG->getCategories()->getCategory(p);
+                PTG->getRuleDeps(p, Rules);
+            }
 
             inline void insert(Pointee p)
             {
-                Elements.insert(p);
+                Elements.push_back(p);
             }
 
-            ElementsTy& getElements(void) { return Elements; }
-            const ElementsTy& getElements(void) const { return Elements; }
+            // move all elements of b here, copying the smaller vector
+            void takeElements(Node *b)
+            {
+                if (Elements.size() < b->Elements.size()) {
+                    Elements.swap(b->Elements);
+                    std::swap(Sorted, b->Sorted);
+                }
+
+                Elements.append(b->Elements.begin(), b->Elements.end());
+                b->Elements.clear();
+                b->Sorted = 0;
+            }
+
+            ElementsTy& getElements(void)
+            {
+                sortElements();
+                return Elements;
+            }
+            const ElementsTy& getElements(void) const
+            {
+                sortElements();
+                return Elements;
+            }
+
+            // representative of the node, compresses the path on the way
+            Node *find(void) const
+            {
+                Node *Root = Parent;
+
+                while (Root->Parent != Root)
+                    Root = Root->Parent;
+
+                for (Node *N = Parent; N != Root; ) {
+                    Node *Next = N->Parent;
+                    N->Parent = Root;
+                    N = Next;
+                }
+                Parent = Root;
+
+                return Root;
+            }
+
+            bool isRepresentative(void) const { return Parent == this; }
+
+            // neighbour with category c (resolved), or NULL
+            Node *getEdge(unsigned int c) const
+            {
+                return Edges[c] ? Edges[c]->find() : NULL;
+            }
 
-            EdgesTy getEdges(void) { return Edges; }
-            const Node * const * getEdges(void) const { return Edges; }
             ReferencesTy& getReferences(void) { return References; }
             const ReferencesTy& getReferences(void) const { return References; }
+            RulesTy& getRules(void) { return Rules; }
+            const RulesTy& getRules(void) const { return Rules; }
 
             Pointee getOrigin() { return origin; }
             const Pointee& getOrigin() const { return origin; }
@@ -211,59 +528,73 @@ namespace ptr {
             // Merge nodes with same category if necessary.
             bool addNeighbour(Node *n)
             {
+                Node *Self = find();
+
+                // this node was merged, the edge belongs to the representative
+                if (Self != this)
+                    return Self->addNeighbour(n);
+
+                n = n->find();
 
                 unsigned c = n->getCategory();
                 assert(c < NODE_EDGES_NUM);
 
-                if (Edges[c]) {
-                    if (Edges[c] == n)
+                if (Node *e = getEdge(c)) {
+                    if (e == n)
                         return false;
                     // if there already exists a node with the same
                     // category, merge them
-                    PTG->mergeNodes(Edges[c], n);
+                    PTG->mergeNodes(e, n);
                 } else {
                     Edges[c] = n;
                     n->References.insert(this);
                     ++EdgesNo;
+                    PTG->nodeChanged(this);
                 }
 
                 return true;
             }
 
-            void removeNeighbour(Node *n)
-            {
-                unsigned c = n->getCategory();
-                assert(Edges[c] == n);
-                Edges[c] = NULL; --EdgesNo;
-            }
-
-            void removeNeighbour(unsigned int c)
-            {
-                assert(Edges[c]);
-
-                --EdgesNo;
-                Edges[c] = NULL;
-            }
-
             inline bool hasNeighbours(void) const
             {
                 return EdgesNo > 0;
             }
 
             void convertToPointsToSets(PointsToSets& PS,
+                                       PointeeSetIntersections &Cache,
                                        bool intersect = false) const;
 
             void dump(void) const;
 
         private:
-            ElementsTy Elements;      // items in node
+            // sort the unsorted tail and merge it with the sorted prefix
+            void sortElements(void) const
+            {
+                if (Sorted == Elements.size())
+                    return;
+
+                std::sort(Elements.begin() + Sorted, Elements.end());
+                std::inplace_merge(Elements.begin(), Elements.begin() + Sorted,
+                                   Elements.end());
+                Sorted = Elements.size();
+            }
+
+            mutable ElementsTy Elements; // items in node
+            mutable unsigned Sorted;     // length of the sorted prefix
             ReferencesTy References;  // what nodes points to this one?
+            RulesTy Rules;            // what rules read this node?
             Node *Edges[NODE_EDGES_NUM] = {0};
             unsigned int EdgesNo = 0; // number of outgoing edges
 
             Pointee origin;
             PointsToGraph *PTG;
             unsigned int Category;
+
+            // union-find
+            mutable Node *Parent;
+            unsigned int Rank;
+
+            friend class PointsToGraph;
         };
 
         const PointsToCategories *getCategories(void) const {  return PTC; }
@@ -284,6 +615,8 @@ namespace ptr {
 
         bool insertDerefBoth(Node *PointerNode, Node *LocationNode);
 
+        // allocate a node in the arena
+        Node *createNode(Pointee p);
         // add new node
         Node *addNode(Pointee p);
 
@@ -292,18 +625,34 @@ namespace ptr {
 
         Node *findNode(Pointee p) const;
 
-        // replace node in map
-        void replaceNode(Node *, Node *);
-        // make all nodes that points to the first node,
-        // point to the second node instead
-        void replaceEdges(Node *, Node *);
-
+        // union the two nodes, union by rank
         void mergeNodes(Node *, Node *);
-        // hash table Pointer->Node
+        // hash table Pointer->Node, the node may be an absorbed one
         std::unordered_map<Pointer, Node *> Nodes;
+        // all nodes ever created, including the absorbed ones
+        std::vector<Node *> AllNodes;
+        // memory for the nodes, freed at once with the graph
+        llvm::BumpPtrAllocator Allocator;
+        unsigned long Merges;
         const ProgramStructure *PS;
         PointsToCategories *PTC;
 
+        // --------------------------------------------------------------------
+        // worklist of rules -- a rule is applied again only when a node it
+        // reads (or a node one step further) has changed
+        // --------------------------------------------------------------------
+        std::deque<unsigned> Worklist;
+        std::vector<bool> Scheduled;
+        // pointer -> indices of rules reading node of the pointer
+        std::unordered_map<Pointer, Node::RulesTy> RuleDeps;
+        unsigned long RuleApplications;
+
+        void buildRuleDeps(void);
+        void getRuleDeps(Pointer p, Node::RulesTy& Rules) const;
+        void schedule(const Node::RulesTy& Rules);
+        // node has got new edges or elements
+        void nodeChanged(Node *n);
+
         // --------------------------------------------------------------------
         // applyRules functions -> convert ruleCodes into points-to-graph
         // --------------------------------------------------------------------
@@ -360,8 +709,24 @@ namespace llvm { namespace ptr {
   getPointsToSet(const llvm::Value *const &memLoc, const PointsToSets &S,
 		  const int offset = -1);
 
+  enum {
+    RESULT_ADDRESS_TAKEN_ONLY = 1 << 0 /* -pta-address-taken-only */
+  };
+
+  // the options which change the points-to sets, as RESULT_* bits
+  unsigned getResultOptions();
+
+  // Threads == 0 means the value of -pta-threads
   PointsToSets &computePointsToSets(const ProgramStructure &P, PointsToSets &S,
-                                    unsigned int K = 0);
+                                    unsigned int K = 0,
+                                    unsigned int Threads = 0);
+
+  // constant byte offset added by gep, isArray is set if it indexes an array
+  int64_t accumulateConstantOffset(const llvm::GetElementPtrInst *gep,
+                                   const llvm::DataLayout &DL, bool &isArray);
+  // size of the global or alloca V, false if the analysis does not know it
+  bool getAllocatedSize(const llvm::DataLayout &DL, const llvm::Value *V,
+                        uint64_t &size);
 
 }}
 
@@ -10,6 +10,7 @@
 // A survey of program slicing techniques
 //===----------------------------------------------------------------------===//
 
+#include <climits>
 #include <ctype.h>
 #include <map>
 
@@ -20,6 +21,8 @@
 #include "llvm/Module.h"
 #include "llvm/Pass.h"
 #include "llvm/TypeBuilder.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/Analysis/PostDominators.h"
 #include "llvm/Support/CFG.h"
@@ -28,16 +31,31 @@
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 
 #include "PostDominanceFrontier.h"
+#include "../Cache/AnalysisPasses.h"
 #include "../Callgraph/Callgraph.h"
 #include "../Modifies/Modifies.h"
 #include "../PointsTo/PointsTo.h"
 #include "../Languages/LLVMSupport.h"
+#include "../Support/Stats.h"
+#include "../Support/Trace.h"
 
 #include "FunctionStaticSlicer.h"
 
 using namespace llvm;
 using namespace llvm::slicing;
 
+static stats::Histogram RCIterations("slicer.rc-iterations",
+    "RC sweeps needed by one computeRC");
+static stats::Counter RCVisits("slicer.rc-visits",
+    "Instructions visited while computing RC");
+static stats::Histogram BCRounds("slicer.bc-rounds",
+    "RC/SC/BC rounds needed by one function slice");
+static stats::Counter Built("slicer.defref-built",
+    "Functions whose DEF/REF sets were built");
+static stats::Counter PDFRunsAvoided("slicer.pdf-runs-avoided",
+    "computeBC calls served by cached control dependences instead of the "
+    "pass manager");
+
 static uint64_t getSizeOfMem(const Value *val) {
 
   if (const ConstantInt *CI = dyn_cast<ConstantInt>(val)) {
@@ -52,15 +70,28 @@ static uint64_t getSizeOfMem(const Value *val) {
   return 64;
 }
 
+/*
+ * <loc, [off, off + len)> as a single pointee
+ */
+static ptr::PointsToSets::Pointee getArrayPointee(
+    const ptr::PointsToSets::Pointee &p, uint64_t lenConst) {
+  int lo = p.second < 0 ? 0 : p.second;
+  uint64_t hi = lo + lenConst;
+
+  if (hi > INT_MAX)
+    hi = INT_MAX;
+
+  return ptr::PointsToSets::Pointee(p.first, ptr::PointeeRange::encode(lo, hi));
+}
+
 void InsInfo::addDEFArray(const ptr::PointsToSets &PS, const Value *V,
     uint64_t lenConst) {
-  if (isPointerValue(V)) {
+  if (isPointerValue(V) && lenConst) {
     typedef ptr::PointsToSets::PointsToSet PTSet;
 
     const PTSet &L = getPointsToSet(V, PS);
     for (PTSet::const_iterator p = L.begin(); p != L.end(); ++p)
-      for (uint64_t i = 0; i < lenConst; i++)
-	addDEF(Pointee(p->first, p->second + i));
+      addDEF(getArrayPointee(*p, lenConst));
   }
 }
 
@@ -85,13 +116,12 @@ void InsInfo::handleVariousFuns(const ptr::PointsToSets &PS, const CallInst *C,
 
 void InsInfo::addREFArray(const ptr::PointsToSets &PS, const Value *V,
     uint64_t lenConst) {
-  if (isPointerValue(V)) {
+  if (isPointerValue(V) && lenConst) {
     typedef ptr::PointsToSets::PointsToSet PTSet;
 
     const PTSet &R = getPointsToSet(V, PS);
     for (PTSet::const_iterator p = R.begin(); p != R.end(); ++p)
-      for (uint64_t i = 0; i < lenConst; i++)
-	addREF(Pointee(p->first, p->second + i));
+      addREF(getArrayPointee(*p, lenConst));
   }
 }
 
@@ -277,6 +307,8 @@ namespace {
       void getAnalysisUsage(AnalysisUsage &AU) const {
         AU.addRequired<PostDominatorTree>();
         AU.addRequired<PostDominanceFrontier>();
+        AU.addRequired<cache::PointsToAnalysis>();
+        AU.addRequired<cache::ModifiesAnalysis>();
       }
     private:
       bool runOnFunction(Function &F, const ptr::PointsToSets &PS,
@@ -287,31 +319,141 @@ namespace {
 static RegisterPass<FunctionSlicer> X("slice", "Slices the code");
 char FunctionSlicer::ID;
 
-FunctionStaticSlicer::~FunctionStaticSlicer() {
-  for (InsInfoMap::const_iterator I = insInfoMap.begin(), E = insInfoMap.end();
-       I != E; I++)
-    delete I->second;
+std::pair<unsigned, bool> VarNumbering::insert(const Pointee &var) {
+  std::pair<std::unordered_map<Pointee, unsigned>::iterator, bool> ret =
+    ids.insert(std::make_pair(var, vars.size()));
+
+  if (ret.second) {
+    vars.push_back(var);
+    bases[var.first].push_back(ret.first->second);
+  }
+
+  return std::make_pair(ret.first->second, ret.second);
 }
 
-typedef llvm::SmallVector<const Instruction *, 10> SuccList;
+const VarNumbering::IdList &VarNumbering::sameBase(const Value *v) const {
+  static const IdList empty;
+  std::unordered_map<const Value *, IdList>::const_iterator I = bases.find(v);
 
-static SuccList getSuccList(const Instruction *i) {
-  SuccList succList;
-  const BasicBlock *bb = i->getParent();
-  if (i != &bb->back()) {
-    BasicBlock::const_iterator I(i);
-    I++;
-    succList.push_back(&*I);
-  } else {
-    for (succ_const_iterator I = succ_begin(bb), E = succ_end(bb); I != E; I++)
-      succList.push_back(&(*I)->front());
+  return I == bases.end() ? empty : I->second;
+}
+
+/*
+ * Number the instructions and store the successors of each one: the next
+ * instruction in the block, or the first ones of the successor blocks.
+ */
+void FunctionStaticSlicer::build() {
+  if (built)
+    return;
+
+  DenseMap<const BasicBlock *, unsigned> first;
+  unsigned count = 0;
+
+  for (Function::const_iterator B = fun.begin(), E = fun.end(); B != E; ++B) {
+    first[&*B] = count;
+    count += B->size();
+  }
+
+  built = true;
+  ++Built;
+  insInfos.reserve(count);
+  for (inst_iterator I = inst_begin(fun), E = inst_end(fun); I != E; ++I) {
+    insIndex[&*I] = insInfos.size();
+    insInfos.push_back(InsInfo(&*I, PS, MOD));
+  }
+
+  succBegin.reserve(count + 1);
+  succs.reserve(count + fun.size());
+  succBegin.push_back(0);
+  for (Function::const_iterator B = fun.begin(), E = fun.end(); B != E; ++B) {
+    unsigned k = first[&*B];
+    for (unsigned last = k + B->size() - 1; k < last; ++k) {
+      succs.push_back(k + 1);
+      succBegin.push_back(succs.size());
+    }
+    for (succ_const_iterator I = succ_begin(&*B), IE = succ_end(&*B); I != IE;
+         ++I)
+      succs.push_back(first[*I]);
+    succBegin.push_back(succs.size());
+  }
+
+  numberVars();
+}
+
+/*
+ * Number all variables of DEF and REF sets and build the bitvectors.
+ */
+void FunctionStaticSlicer::numberVars() {
+  for (unsigned k = 0; k < insInfos.size(); ++k) {
+    InsInfo *ii = &insInfos[k];
+
+    for (ValSet::const_iterator II = ii->DEF_begin(), EE = ii->DEF_end();
+         II != EE; ++II) {
+      vars.insert(*II);
+      definers[II->first].push_back(ii);
+    }
+    for (ValSet::const_iterator II = ii->REF_begin(), EE = ii->REF_end();
+         II != EE; ++II)
+      InsInfo::setBit(ii->getREFBits(), vars.insert(*II).first);
+  }
+
+  /* now all variables a DEF can cover or overlap with are known */
+  for (unsigned k = 0; k < insInfos.size(); ++k) {
+    InsInfo *ii = &insInfos[k];
+
+    for (ValSet::const_iterator II = ii->DEF_begin(), EE = ii->DEF_end();
+         II != EE; ++II) {
+      const VarNumbering::IdList &same = vars.sameBase(II->first);
+      for (VarNumbering::IdList::const_iterator v = same.begin(),
+           ve = same.end(); v != ve; ++v)
+        addDEFBits(ii, *v);
+    }
+  }
+}
+
+/*
+ * Variables coming later (criteria, relevant variables of other functions)
+ * have to be added to the DEF bits of instructions defining them.
+ */
+unsigned FunctionStaticSlicer::numberVar(const Pointee &var) {
+  std::pair<unsigned, bool> id = vars.insert(var);
+
+  if (id.second) {
+    std::unordered_map<const Value *, SmallVector<InsInfo *, 4> >::iterator I =
+      definers.find(var.first);
+    if (I != definers.end())
+      for (SmallVector<InsInfo *, 4>::const_iterator II = I->second.begin(),
+           EE = I->second.end(); II != EE; ++II)
+        addDEFBits(*II, id.first);
   }
-  return succList;
+
+  return id.first;
 }
 
+void FunctionStaticSlicer::addDEFBits(InsInfo *ii, unsigned id) {
+  const Pointee &var = vars.get(id);
+
+  for (ValSet::const_iterator I = ii->DEF_begin(), E = ii->DEF_end();
+       I != E; ++I) {
+    if (coversValue(*I, var))
+      InsInfo::setBit(ii->getDEFCover(), id);
+    if (sameValues(*I, var))
+      InsInfo::setBit(ii->getDEFOverlap(), id);
+  }
+}
+
+/*
+ * Pointees may be byte ranges, so "same" means sharing a byte here. A
+ * definition kills a relevant pointee only if it covers all of it.
+ */
 bool FunctionStaticSlicer::sameValues(const Pointee &val1, const Pointee &val2)
 {
-  return val1.first == val2.first && val1.second == val2.second;
+  return ptr::PointeeRange::overlap(val1, val2);
+}
+
+bool FunctionStaticSlicer::coversValue(const Pointee &def, const Pointee &val)
+{
+  return ptr::PointeeRange::covers(def, val);
 }
 
 /*
@@ -320,43 +462,26 @@ bool FunctionStaticSlicer::sameValues(const Pointee &val1, const Pointee &val2)
  *   {v| v \in REF(i), DEF(i) \cap RC(j) \neq \emptyset}
  */
 bool FunctionStaticSlicer::computeRCi(InsInfo *insInfoi, InsInfo *insInfoj) {
+  BitVector &RCi = insInfoi->getRC();
+  const BitVector &RCj = insInfoj->getRC();
   bool changed = false;
 
   /* {v| v \in RC(j), v \notin DEF(i)} */
-  for (ValSet::const_iterator I = insInfoj->RC_begin(),
-       E = insInfoj->RC_end(); I != E; I++) {
-    const Pointee &RCj = *I;
-    bool in_DEF = false;
-    for (ValSet::const_iterator II = insInfoi->DEF_begin(),
-         EE = insInfoi->DEF_end(); II != EE; II++)
-      if (sameValues(*II, RCj)) {
-        in_DEF = true;
-        break;
-      }
-    if (!in_DEF)
-      if (insInfoi->addRC(RCj))
-        changed = true;
-  }
-  /* DEF(i) \cap RC(j) \neq \emptyset */
-  bool isect_nonempty = false;
-  for (ValSet::const_iterator I = insInfoi->DEF_begin(),
-       E = insInfoi->DEF_end(); I != E && !isect_nonempty; I++) {
-    const Pointee &DEFi = *I;
-    for (ValSet::const_iterator II = insInfoj->RC_begin(),
-         EE = insInfoj->RC_end(); II != EE; II++) {
-      if (sameValues(DEFi, *II)) {
-        isect_nonempty = true;
-        break;
-      }
-    }
+  scratch = RCj;
+  scratch.reset(insInfoi->getDEFCover());
+  if (scratch.test(RCi)) {
+    RCi |= scratch;
+    changed = true;
   }
 
-  /* {v| v \in REF(i), ...} */
-  if (isect_nonempty)
-    for (ValSet::const_iterator I = insInfoi->REF_begin(),
-         E = insInfoi->REF_end(); I != E; I++)
-      if (insInfoi->addRC(*I))
-        changed = true;
+  /* {v| v \in REF(i), DEF(i) \cap RC(j) \neq \emptyset} */
+  if (insInfoi->getDEFOverlap().anyCommon(RCj)) {
+    const BitVector &REFi = insInfoi->getREFBits();
+    if (REFi.test(RCi)) {
+      RCi |= REFi;
+      changed = true;
+    }
+  }
 #ifdef DEBUG_RC
   errs() << "  " << __func__ << "2 END";
   if (changed)
@@ -366,89 +491,114 @@ bool FunctionStaticSlicer::computeRCi(InsInfo *insInfoi, InsInfo *insInfoj) {
   return changed;
 }
 
-bool FunctionStaticSlicer::computeRCi(InsInfo *insInfoi) {
-  const Instruction *i = insInfoi->getIns();
-  bool changed = false;
-#ifdef DEBUG_RC
-  errs() << "  " << __func__ << ": " << i->getOpcodeName();
-  if (i->hasName())
-    errs() << " (" << i->getName() << ")";
-  errs() << '\n';
-  errs() << "    DUMP: ";
-  i->print(errs());
-  errs() << '\n';
-#endif
-  SuccList succList = getSuccList(i);
-  for (SuccList::const_iterator I = succList.begin(), E = succList.end();
-       I != E; I++)
-    changed |= computeRCi(insInfoi, getInsInfo(*I));
+/*
+ * Number the blocks in post-order (successors first, unreachable blocks at
+ * the end) and remember their instructions bottom-up, so that the solver
+ * below does not need to look anything up.
+ */
+void FunctionStaticSlicer::buildBlocks() {
+  DenseMap<const BasicBlock *, unsigned> index;
 
-  return changed;
+  for (po_iterator<Function *> I = po_begin(&fun), E = po_end(&fun);
+       I != E; ++I) {
+    index[*I] = blocks.size();
+    blocks.push_back(BlockInfo(*I));
+  }
+  for (Function::const_iterator I = fun.begin(), E = fun.end(); I != E; ++I)
+    if (!index.count(&*I)) {
+      index[&*I] = blocks.size();
+      blocks.push_back(BlockInfo(&*I));
+    }
+
+  for (unsigned b = 0; b < blocks.size(); ++b) {
+    BlockInfo &BI = blocks[b];
+    typedef std::reverse_iterator<BasicBlock::const_iterator> rev;
+
+    for (rev I = rev(BI.bb->end()), E = rev(BI.bb->begin()); I != E; ++I)
+      BI.insns.push_back(getInsInfo(&*I));
+    for (succ_const_iterator I = succ_begin(BI.bb), E = succ_end(BI.bb);
+         I != E; ++I) {
+      unsigned s = index[*I];
+      BI.succs.push_back(s);
+      blocks[s].preds.push_back(b);
+    }
+  }
 }
 
+/*
+ * Backward dataflow over blocks. A block is re-solved only when RC at the
+ * entry of one of its successors has changed. One iteration is a sweep over
+ * the pending blocks in post-order.
+ */
 void FunctionStaticSlicer::computeRC() {
-  bool changed;
+  if (blocks.empty())
+    buildBlocks();
+
+  /* criteria may have been added anywhere, start with all the blocks */
+  BitVector pending(blocks.size(), true);
+  unsigned iterations = 0;
+  unsigned long visits = rcVisits;
+
+  while (pending.any()) {
+    ++iterations;
+    ++rcIterations;
 #ifdef DEBUG_RC
-  int it = 1;
+    errs() << __func__ << ": ============== Iteration " << rcIterations << '\n';
 #endif
-  do {
-    changed = false;
+    for (int b = pending.find_first(); b != -1; b = pending.find_next(b)) {
+      BlockInfo &BI = blocks[b];
+      bool entryChanged = false;
+
+      pending.reset(b);
+
+      for (unsigned k = 0; k < BI.insns.size(); ++k) {
+        InsInfo *insInfo = BI.insns[k];
+        bool changed = false;
+
+        ++rcVisits;
 #ifdef DEBUG_RC
-    errs() << __func__ << ": ============== Iteration " << it++ << '\n';
+        errs() << "  " << __func__ << ": ";
+        insInfo->getIns()->print(errs());
+        errs() << '\n';
 #endif
-    typedef std::reverse_iterator<Function::iterator> revFun;
-    for (revFun I = revFun(fun.end()), E = revFun(fun.begin()); I != E; I++) {
-      typedef std::reverse_iterator<BasicBlock::iterator> rev;
-      InsInfo *past = NULL;
-      for (rev II = rev(I->end()), EE = rev(I->begin()); II != EE; ++II) {
-        InsInfo *insInfo = getInsInfo(&*II);
-        if (!past)
-          changed |= computeRCi(insInfo);
-        else
-          changed |= computeRCi(insInfo, past);
-        past = insInfo;
+        if (k == 0) {
+          for (unsigned s = 0; s < BI.succs.size(); ++s)
+            changed |= computeRCi(insInfo, blocks[BI.succs[s]].insns.back());
+        } else
+          changed |= computeRCi(insInfo, BI.insns[k - 1]);
+
+        entryChanged = changed;
       }
+
+      if (entryChanged)
+        for (unsigned p = 0; p < BI.preds.size(); ++p)
+          pending.set(BI.preds[p]);
     }
-  } while (changed);
+  }
+
+  RCIterations.add(iterations);
+  RCVisits.add(rcVisits - visits);
 }
 
 /*
  * SC(i)={i| DEF(i) \cap RC(j) \neq \emptyset}
  */
-void FunctionStaticSlicer::computeSCi(const Instruction *i, const Instruction *j) {
-  InsInfo *insInfoi = getInsInfo(i), *insInfoj = getInsInfo(j);
-
-  bool isect_nonempty = false;
-  for (ValSet::const_iterator I = insInfoi->DEF_begin(),
-       E = insInfoi->DEF_end(); I != E && !isect_nonempty; I++) {
-    const Pointee &DEFi = *I;
-    for (ValSet::const_iterator II = insInfoj->RC_begin(),
-         EE = insInfoj->RC_end(); II != EE; II++) {
-      if (sameValues(DEFi, *II)) {
-        isect_nonempty = true;
-        break;
-      }
-    }
-  }
-
-  if (isect_nonempty) {
+void FunctionStaticSlicer::computeSCi(InsInfo *insInfoi,
+                                      const InsInfo *insInfoj) {
+  if (insInfoi->getDEFOverlap().anyCommon(insInfoj->getRC())) {
     insInfoi->deslice();
 #ifdef DEBUG_SLICING
     errs() << "XXXXXXXXXXXXXY ";
-    i->print(errs());
+    insInfoi->getIns()->print(errs());
     errs() << '\n';
 #endif
   }
 }
 
 void FunctionStaticSlicer::computeSC() {
-  for (inst_iterator I = inst_begin(fun), E = inst_end(fun); I != E; I++) {
-    const Instruction *i = &*I;
-    SuccList succList = getSuccList(i);
-    for (SuccList::const_iterator II = succList.begin(), EE = succList.end();
-         II != EE; II++)
-      computeSCi(i, *II);
-  }
+  for (unsigned i = 0; i < insInfos.size(); ++i)
+    for (unsigned s = succBegin[i]; s < succBegin[i + 1]; ++s)
+      computeSCi(&insInfos[i], &insInfos[succs[s]]);
 }
 
 bool FunctionStaticSlicer::computeBC() {
@@ -456,22 +606,30 @@ bool FunctionStaticSlicer::computeBC() {
 #ifdef DEBUG_BC
   errs() << __func__ << " ============ BEG\n";
 #endif
-  PostDominanceFrontier &PDF = MP->getAnalysis<PostDominanceFrontier>(fun);
-  for (inst_iterator I = inst_begin(fun), E = inst_end(fun); I != E; I++) {
-    Instruction *i = &*I;
-    const InsInfo *ii = getInsInfo(i);
-    if (ii->isSliced())
+  if (controlDepsCached)
+    ++PDFRunsAvoided;
+  else
+    cacheControlDeps();
+
+  unsigned k = 0, b = 0;
+  for (Function::const_iterator B = fun.begin(), E = fun.end(); B != E;
+       ++B, ++b) {
+    unsigned first = k;
+
+    k += B->size();
+    if (ctrlBegin[b] == ctrlBegin[b + 1])
       continue;
-    BasicBlock *BB = i->getParent();
+    /* the rest of the block would add the same dependences again */
+    for (unsigned i = first; i < k; ++i)
+      if (!insInfos[i].isSliced()) {
 #ifdef DEBUG_BC
-    errs() << "  ";
-    i->print(errs());
-    errs() << " -> bb=" << BB->getName() << '\n';
+        errs() << "  ";
+        insInfos[i].getIns()->print(errs());
+        errs() << " -> bb=" << B->getName() << '\n';
 #endif
-    PostDominanceFrontier::const_iterator frontier = PDF.find(BB);
-    if (frontier == PDF.end())
-      continue;
-    changed |= updateRCSC(frontier->second.begin(), frontier->second.end());
+        changed |= updateRCSC(ctrlBegin[b], ctrlBegin[b + 1]);
+        break;
+      }
   }
 #ifdef DEBUG_BC
   errs() << __func__ << " ============ END\n";
@@ -479,33 +637,57 @@ bool FunctionStaticSlicer::computeBC() {
   return changed;
 }
 
-bool FunctionStaticSlicer::updateRCSC(
-                PostDominanceFrontier::DomSetType::const_iterator start,
-                PostDominanceFrontier::DomSetType::const_iterator end) {
+/*
+ * Turn the post-dominance frontiers into the branches each block depends on,
+ * so that the pass manager is asked once per function. The CFG does not
+ * change until slice().
+ */
+void FunctionStaticSlicer::cacheControlDeps() {
+  if (controlDepsCached)
+    return;
+
+  build();
+
+  PostDominanceFrontier &PDF = MP->getAnalysis<PostDominanceFrontier>(fun);
+
+  ctrlBegin.reserve(fun.size() + 1);
+  ctrlBegin.push_back(0);
+  for (Function::iterator B = fun.begin(), E = fun.end(); B != E; ++B) {
+    PostDominanceFrontier::const_iterator F = PDF.find(&*B);
+    if (F != PDF.end())
+      for (PostDominanceFrontier::DomSetType::const_iterator
+           I = F->second.begin(), IE = F->second.end(); I != IE; ++I)
+        ctrlDeps.push_back(getIndex(&(*I)->back()));
+    ctrlBegin.push_back(ctrlDeps.size());
+  }
+  controlDepsCached = true;
+}
+
+bool FunctionStaticSlicer::updateRCSC(unsigned start, unsigned end) {
   bool changed = false;
 #ifdef DEBUG_RC
   errs() << __func__ << " ============ BEG\n";
 #endif
   for (; start != end; start++) {
-    const BasicBlock *BB = *start;
-    const Instruction &i = BB->back();
-    InsInfo *ii = getInsInfo(&i);
+    InsInfo *ii = &insInfos[ctrlDeps[start]];
     /* SC = BC \cup ... */
 #ifdef DEBUG_SLICING
-    errs() << "XXXXXXXXXXXXXX " << BB->getName() << " ";
-    i.print(errs());
+    errs() << "XXXXXXXXXXXXXX " << ii->getIns()->getParent()->getName() << " ";
+    ii->getIns()->print(errs());
     errs() << '\n';
 #endif
     ii->deslice();
     /* RC = ... \cup \cup(b \in BC) RB */
-    for (ValSet::const_iterator II = ii->REF_begin(), EE = ii->REF_end();
-         II != EE; II++)
-      if (ii->addRC(*II)) {
-        changed = true;
+    const BitVector &REF = ii->getREFBits();
+    BitVector &RC = ii->getRC();
+    if (REF.test(RC)) {
+      RC |= REF;
+      changed = true;
 #ifdef DEBUG_RC
-        errs() << "  added " << (*II)->getName() << "\n";
+      errs() << "  added REF of " << ii->getIns()->getParent()->getName() <<
+        "\n";
 #endif
-      }
+    }
   }
 #ifdef DEBUG_RC
   errs() << __func__ << " ============ END: changed=" << changed << "\n";
@@ -526,6 +708,39 @@ static bool canSlice(const Instruction &i) {
   return true;
 }
 
+void FunctionStaticSlicer::saveState(State &S) const {
+  S.RC.clear();
+  S.RC.reserve(insInfos.size());
+  S.desliced.clear();
+  S.desliced.resize(insInfos.size());
+
+  for (unsigned k = 0; k < insInfos.size(); ++k) {
+    S.RC.push_back(insInfos[k].getRC());
+    if (!insInfos[k].isSliced())
+      S.desliced.set(k);
+  }
+}
+
+void FunctionStaticSlicer::restoreState(const State &S) {
+  /* saved before build(), i.e. with nothing relevant and all sliced */
+  if (S.RC.empty()) {
+    for (unsigned k = 0; k < insInfos.size(); ++k)
+      insInfos[k].restore(BitVector(), true);
+    return;
+  }
+
+  assert(S.RC.size() == insInfos.size() && "State of another function?");
+
+  for (unsigned k = 0; k < insInfos.size(); ++k)
+    insInfos[k].restore(S.RC[k], !S.desliced.test(k));
+}
+
+bool FunctionStaticSlicer::inSlice(const Instruction *I) const {
+  if (!built)
+    return !canSlice(*I);
+  return !getInsInfo(I)->isSliced() || !canSlice(*I);
+}
+
 void FunctionStaticSlicer::dump() {
 #ifdef DEBUG_DUMP
   for (inst_iterator I = inst_begin(fun), E = inst_end(fun); I != E; I++) {
@@ -548,7 +763,7 @@ void FunctionStaticSlicer::dump() {
       II->first->dump();
     }
     errs() << "    RC:\n";
-    for (ValSet::const_iterator II = ii->RC_begin(), EE = ii->RC_end();
+    for (relevant_iterator II = relevant_begin(&i), EE = relevant_end(&i);
          II != EE; II++) {
       errs() << "      OFF=" << II->second << " ";
       II->first->dump();
@@ -561,10 +776,16 @@ void FunctionStaticSlicer::dump() {
  * this method calculates the static slice for the CFG
  */
 void FunctionStaticSlicer::calculateStaticSlice() {
+  trace::Scope T("slicer.calculate", fun.getName());
 #ifdef DEBUG_SLICE
   errs() << __func__ << " ============ BEG\n";
 #endif
+  unsigned rounds = 0;
+
+  build();
+
   do {
+    ++rounds;
 #ifdef DEBUG_SLICE
     errs() << __func__ << " ======= compute RC\n";
 #endif
@@ -579,6 +800,7 @@ void FunctionStaticSlicer::calculateStaticSlice() {
 #endif
   } while (computeBC());
 
+  BCRounds.add(rounds);
   dump();
 
 #ifdef DEBUG_SLICE
@@ -591,13 +813,13 @@ bool FunctionStaticSlicer::slice() {
   errs() << __func__ << " ============ BEG\n";
 #endif
   bool removed = false;
-  for (inst_iterator I = inst_begin(fun), E = inst_end(fun); I != E;) {
+
+  unsigned k = 0;
+  for (inst_iterator I = inst_begin(fun), E = inst_end(fun); I != E; ++k) {
     Instruction &i = *I;
-    InsInfoMap::iterator ii_iter = insInfoMap.find(&i);
-    assert(ii_iter != insInfoMap.end());
-    const InsInfo *ii = ii_iter->second;
     ++I;
-    if (ii->isSliced() && canSlice(i)) {
+    /* no criterion reached a function which was never built */
+    if ((!built || insInfos[k].isSliced()) && canSlice(i)) {
 #ifdef DEBUG_SLICE
       errs() << "  removing:";
       i.print(errs());
@@ -605,12 +827,22 @@ bool FunctionStaticSlicer::slice() {
 #endif
       i.replaceAllUsesWith(UndefValue::get(i.getType()));
       i.eraseFromParent();
-      insInfoMap.erase(ii_iter);
-      delete ii;
-
       removed = true;
     }
   }
+
+  /* the numbering refers to removed instructions */
+  blocks.clear();
+  definers.clear();
+  insIndex.clear();
+  insInfos.clear();
+  succBegin.clear();
+  succs.clear();
+  ctrlBegin.clear();
+  ctrlDeps.clear();
+  controlDepsCached = false;
+  built = false;
+
   return removed;
 }
 
@@ -620,11 +852,11 @@ bool FunctionStaticSlicer::slice() {
  * These are irrelevant to the code, so may be removed completely with their
  * bodies.
  */
-void FunctionStaticSlicer::removeUndefBranches(ModulePass *MP, Function &F) {
+void FunctionStaticSlicer::removeUndefBranches(PostDominatorTree &PDT,
+                                               Function &F) {
 #ifdef DEBUG_SLICE
   errs() << __func__ << " ============ Removing unused branches\n";
 #endif
-  PostDominatorTree &PDT = MP->getAnalysis<PostDominatorTree>(F);
   typedef llvm::SmallVector<const BasicBlock *, 10> Unsafe;
   Unsafe unsafe;
 
@@ -679,7 +911,7 @@ void FunctionStaticSlicer::removeUndefBranches(ModulePass *MP, Function &F) {
  *
  * These are irrelevant to the code, so may be removed completely.
  */
-void FunctionStaticSlicer::removeUndefCalls(ModulePass *MP, Function &F) {
+void FunctionStaticSlicer::removeUndefCalls(Function &F) {
   for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E;) {
     CallInst *CI = dyn_cast<CallInst>(&*I);
     ++I;
@@ -692,8 +924,19 @@ void FunctionStaticSlicer::removeUndefCalls(ModulePass *MP, Function &F) {
 
 void FunctionStaticSlicer::removeUndefs(ModulePass *MP, Function &F)
 {
-  removeUndefBranches(MP, F);
-  removeUndefCalls(MP, F);
+  removeUndefs(MP->getAnalysis<PostDominatorTree>(F), F);
+}
+
+/*
+ * For functions the pass manager does not know, e.g. of a cloned module. PDT
+ * has to be computed after slice(), it does not change the CFG though.
+ */
+void FunctionStaticSlicer::removeUndefs(PostDominatorTree &PDT, Function &F)
+{
+  trace::Scope T("slicer.remove-undefs", F.getName());
+
+  removeUndefBranches(PDT, F);
+  removeUndefCalls(F);
 }
 
 static bool handleAssert(Function &F, FunctionStaticSlicer &ss,
@@ -766,31 +1009,60 @@ bool llvm::slicing::findInitialCriterion(Function &F,
       if (callie == F__assert_fail) {
 	added = handleAssert(F, ss, CI);
       }
-    } else if (const ReturnInst *RI = dyn_cast<ReturnInst>(i)) {
-      if (starting) {
-        const Module *M = F.getParent();
-        for (Module::const_global_iterator II = M->global_begin(),
-             EE = M->global_end(); II != EE; ++II) {
-          const GlobalVariable &GV = *II;
-          if (!GV.hasName() || !GV.getName().startswith("__ai_state_"))
-            continue;
-#ifdef DEBUG_INITCRIT
-          errs() << "adding " << GV.getName() << " into " << F.getName() <<
-              " to \n";
-          RI->dump();
-#endif
-          ss.addInitialCriterion(RI, ptr::PointsToSets::Pointee(&GV, -1),
-	      false);
-        }
-      }
     }
   }
+  if (starting)
+    addStartingCriteria(F, ss);
 #ifdef DEBUG_INITCRIT
   errs() << __func__ << " ============ END\n";
 #endif
   return added;
 }
 
+void llvm::slicing::addStartingCriteria(const Function &F,
+                                        FunctionStaticSlicer &ss) {
+  const Module *M = F.getParent();
+
+  for (const_inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
+    const ReturnInst *RI = dyn_cast<ReturnInst>(&*I);
+    if (!RI)
+      continue;
+    for (Module::const_global_iterator II = M->global_begin(),
+         EE = M->global_end(); II != EE; ++II) {
+      const GlobalVariable &GV = *II;
+      if (!GV.hasName() || !GV.getName().startswith("__ai_state_"))
+        continue;
+#ifdef DEBUG_INITCRIT
+      errs() << "adding " << GV.getName() << " into " << F.getName() <<
+          " to \n";
+      RI->dump();
+#endif
+      ss.addInitialCriterion(RI, ptr::PointsToSets::Pointee(&GV, -1), false);
+    }
+  }
+}
+
+void llvm::slicing::findCriteria(const Function &F, Criteria &C) {
+  const Module *M = F.getParent();
+  const Function *F__assert_fail = M->getFunction("__assert_fail");
+  if (!F__assert_fail) /* no cookies in this module */
+    return;
+
+  const Value *aif = M->getGlobalVariable("__ai_init_functions", true);
+
+  for (const_inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
+    const Instruction *i = &*I;
+    if (const StoreInst *SI = dyn_cast<StoreInst>(i)) {
+      const Value *LHS = SI->getPointerOperand();
+      if (LHS->hasName() && LHS->getName().startswith("__ai_state_"))
+        C.push_back(Criterion(SI, ptr::PointsToSets::Pointee(LHS, -1)));
+    } else if (const CallInst *CI = dyn_cast<CallInst>(i)) {
+      if (CI->getCalledFunction() == F__assert_fail)
+        C.push_back(Criterion(CI, ptr::PointsToSets::Pointee(aif, -1)));
+    }
+  }
+}
+
 bool FunctionSlicer::runOnFunction(Function &F, const ptr::PointsToSets &PS,
                            const mods::Modifies &MOD) {
   FunctionStaticSlicer ss(F, this, PS, MOD);
@@ -807,19 +1079,10 @@ bool FunctionSlicer::runOnFunction(Function &F, const ptr::PointsToSets &PS,
 }
 
 bool FunctionSlicer::runOnModule(Module &M) {
-  ptr::PointsToSets PS;
-  {
-    ptr::ProgramStructure P(M);
-    computePointsToSets(P, PS);
-  }
-
-  callgraph::Callgraph CG(M, PS);
-
-  mods::Modifies MOD;
-  {
-    mods::ProgramStructure P1(M);
-    computeModifies(P1, CG, PS, MOD);
-  }
+  const ptr::PointsToSets &PS =
+    getAnalysis<cache::PointsToAnalysis>().getPointsToSets();
+  const mods::Modifies &MOD =
+    getAnalysis<cache::ModifiesAnalysis>().getModifies();
 
   bool modified = false;
   for (Module::iterator I = M.begin(), E = M.end(); I != E; ++I) {
@@ -4,11 +4,17 @@
 #ifndef SLICING_FUNCTIONSTATICSLICER_H
 #define SLICING_FUNCTIONSTATICSLICER_H
 
+#include <iterator>
 #include <map>
+#include <unordered_map>
 #include <utility> /* pair */
+#include <vector>
 
 #include "llvm/Value.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/InstIterator.h"
 
 #include "../PointsTo/PointsTo.h"
@@ -19,6 +25,61 @@ namespace llvm { namespace slicing {
 
 typedef llvm::SmallSetVector<llvm::ptr::PointsToSets::Pointee, 10> ValSet;
 
+/*
+ * Dense numbering of the variables (pointees) a function works with, so that
+ * the dataflow sets can be bitvectors.
+ */
+class VarNumbering {
+  typedef llvm::ptr::PointsToSets::Pointee Pointee;
+
+public:
+  typedef llvm::SmallVector<unsigned, 2> IdList;
+
+  /* number of var and whether it was assigned just now */
+  std::pair<unsigned, bool> insert(const Pointee &var);
+
+  const Pointee &get(unsigned id) const { return vars[id]; }
+  unsigned size() const { return vars.size(); }
+
+  /* numbers of all the variables based on v (with any offset) */
+  const IdList &sameBase(const llvm::Value *v) const;
+
+private:
+  std::vector<Pointee> vars;
+  std::unordered_map<Pointee, unsigned> ids;
+  std::unordered_map<const llvm::Value *, IdList> bases;
+};
+
+/*
+ * Walks the variables whose bits are set.
+ */
+class VarBitsIterator :
+  public std::iterator<std::forward_iterator_tag,
+                       const llvm::ptr::PointsToSets::Pointee> {
+public:
+  VarBitsIterator() : bits(0), vars(0), idx(-1) {}
+  VarBitsIterator(const llvm::BitVector &bits, const VarNumbering &vars) :
+      bits(&bits), vars(&vars), idx(bits.find_first()) {}
+
+  reference operator*() const { return vars->get(idx); }
+  pointer operator->() const { return &operator*(); }
+
+  VarBitsIterator &operator++() { idx = bits->find_next(idx); return *this; }
+  VarBitsIterator operator++(int) {
+    VarBitsIterator tmp = *this;
+    ++*this;
+    return tmp;
+  }
+
+  bool operator==(const VarBitsIterator &RHS) const { return idx == RHS.idx; }
+  bool operator!=(const VarBitsIterator &RHS) const { return idx != RHS.idx; }
+
+private:
+  const llvm::BitVector *bits;
+  const VarNumbering *vars;
+  int idx;
+};
+
 class InsInfo {
 private:
   typedef llvm::ptr::PointsToSets::Pointee Pointee;
@@ -29,20 +90,45 @@ public:
 
   const Instruction *getIns() const { return ins; }
 
-  bool addRC(const Pointee &var) { return RC.insert(var); }
+  bool addRC(unsigned var) { return setBit(RC, var); }
   bool addDEF(const Pointee &var) { return DEF.insert(var); }
   bool addREF(const Pointee &var) { return REF.insert(var); }
   void deslice() { sliced = false; }
+  void restore(const llvm::BitVector &rc, bool isSliced) {
+    RC = rc;
+    sliced = isSliced;
+  }
 
-  ValSet::const_iterator RC_begin() const { return RC.begin(); }
-  ValSet::const_iterator RC_end() const { return RC.end(); }
   ValSet::const_iterator DEF_begin() const { return DEF.begin(); }
   ValSet::const_iterator DEF_end() const { return DEF.end(); }
   ValSet::const_iterator REF_begin() const { return REF.begin(); }
   ValSet::const_iterator REF_end() const { return REF.end(); }
 
+  /*
+   * The sets as bitvectors over the function's VarNumbering. DEFCover holds
+   * the variables some DEF covers entirely (those are killed), DEFOverlap
+   * the ones sharing at least a byte with some DEF.
+   */
+  llvm::BitVector &getRC() { return RC; }
+  const llvm::BitVector &getRC() const { return RC; }
+  llvm::BitVector &getREFBits() { return REFBits; }
+  const llvm::BitVector &getREFBits() const { return REFBits; }
+  llvm::BitVector &getDEFCover() { return DEFCover; }
+  const llvm::BitVector &getDEFCover() const { return DEFCover; }
+  llvm::BitVector &getDEFOverlap() { return DEFOverlap; }
+  const llvm::BitVector &getDEFOverlap() const { return DEFOverlap; }
+
   bool isSliced() const { return sliced; }
 
+  static bool setBit(llvm::BitVector &bits, unsigned i) {
+    if (i >= bits.size())
+      bits.resize(i + 1);
+    if (bits.test(i))
+      return false;
+    bits.set(i);
+    return true;
+  }
+
 private:
   void addDEFArray(const ptr::PointsToSets &PS, const Value *V,
       uint64_t lenConst);
@@ -52,7 +138,8 @@ private:
       const Function *F);
 
   const llvm::Instruction *ins;
-  ValSet RC, DEF, REF;
+  ValSet DEF, REF;
+  llvm::BitVector RC, REFBits, DEFCover, DEFOverlap;
   bool sliced;
 };
 
@@ -60,23 +147,23 @@ class FunctionStaticSlicer {
   typedef llvm::ptr::PointsToSets::Pointee Pointee;
 
 public:
-  typedef std::map<const llvm::Instruction *, InsInfo *> InsInfoMap;
+  typedef VarBitsIterator relevant_iterator;
 
+  /*
+   * The InsInfos (DEF and REF) are built when the first criterion comes or
+   * when the slice is calculated. Until then, everything is sliced.
+   */
   FunctionStaticSlicer(llvm::Function &F, llvm::ModulePass *MP,
                        const llvm::ptr::PointsToSets &PT,
 		       const llvm::mods::Modifies &mods) :
-	  fun(F), MP(MP) {
-    for (llvm::inst_iterator I = llvm::inst_begin(F), E = llvm::inst_end(F);
-	 I != E; ++I)
-      insInfoMap.insert(InsInfoMap::value_type(&*I, new InsInfo(&*I, PT, mods)));
-  }
-  ~FunctionStaticSlicer();
+	  fun(F), MP(MP), PS(PT), MOD(mods), built(false), rcIterations(0),
+	  rcVisits(0), controlDepsCached(false) {}
 
-  ValSet::const_iterator relevant_begin(const llvm::Instruction *I) const {
-    return getInsInfo(I)->RC_begin();
+  relevant_iterator relevant_begin(const llvm::Instruction *I) const {
+    return relevant_iterator(getInsInfo(I)->getRC(), vars);
   }
-  ValSet::const_iterator relevant_end(const llvm::Instruction *I) const {
-    return getInsInfo(I)->RC_end();
+  relevant_iterator relevant_end(const llvm::Instruction *I) const {
+    return relevant_iterator();
   }
 
   ValSet::const_iterator REF_begin(const llvm::Instruction *I) const {
@@ -89,10 +176,13 @@ public:
   template<typename FwdValueIterator>
   bool addCriterion(const llvm::Instruction *ins, FwdValueIterator b,
 		    FwdValueIterator const e, bool desliceIfChanged = false) {
+    if (b == e)
+      return false;
+    build();
     InsInfo *ii = getInsInfo(ins);
     bool change = false;
     for (; b != e; ++b)
-      if (ii->addRC(*b))
+      if (addRC(ii, *b))
         change = true;
     if (change && desliceIfChanged)
       ii->deslice();
@@ -102,14 +192,44 @@ public:
   void addInitialCriterion(const llvm::Instruction *ins,
 			   const Pointee &cond = Pointee(0, 0),
 			   bool deslice = true) {
+    build();
     InsInfo *ii = getInsInfo(ins);
     if (cond.first)
-      ii->addRC(cond);
+      addRC(ii, cond);
     ii->deslice();
   }
+
+  /*
+   * RC and the sliced flags of all the instructions. A slice for another
+   * criterion can start from a saved state, DEF, REF and the numbering of
+   * variables stay as they are.
+   */
+  struct State {
+    std::vector<llvm::BitVector> RC;
+    llvm::BitVector desliced;
+  };
+  void saveState(State &S) const;
+  void restoreState(const State &S);
+
+  /* whether I would be kept by slice() now */
+  bool inSlice(const llvm::Instruction *I) const;
+
   void calculateStaticSlice();
+  /*
+   * Fetch control dependences from the pass manager now, calculateStaticSlice
+   * does so on its first run otherwise. Afterwards, calculateStaticSlice does
+   * not use the ModulePass and can run in parallel with other functions'
+   * slicers.
+   */
+  void cacheControlDeps();
+  /* removes the sliced instructions, the slicer cannot be used afterwards */
   bool slice();
   static void removeUndefs(ModulePass *MP, Function &F);
+  static void removeUndefs(PostDominatorTree &PDT, Function &F);
+
+  /* sweeps and instruction visits of all computeRC calls so far */
+  unsigned long getRCIterations() const { return rcIterations; }
+  unsigned long getRCVisits() const { return rcVisits; }
 
   void addSkipAssert(const llvm::CallInst *CI) {
     skipAssert.insert(CI);
@@ -122,36 +242,107 @@ public:
 private:
   llvm::Function &fun;
   llvm::ModulePass *MP;
-  InsInfoMap insInfoMap;
+  const llvm::ptr::PointsToSets &PS;
+  const llvm::mods::Modifies &MOD;
+  bool built;
+  /*
+   * Instructions numbered in the order of inst_iterator. The successors of
+   * instruction k are succs[succBegin[k]] .. succs[succBegin[k + 1] - 1].
+   */
+  std::vector<InsInfo> insInfos;
+  llvm::DenseMap<const llvm::Instruction *, unsigned> insIndex;
+  std::vector<unsigned> succBegin, succs;
   llvm::SmallSetVector<const llvm::CallInst *, 10> skipAssert;
 
+  VarNumbering vars;
+  /* instructions defining something based on the value */
+  std::unordered_map<const llvm::Value *,
+                     llvm::SmallVector<InsInfo *, 4> > definers;
+  /* temporary for computeRCi, kept to reuse its storage */
+  llvm::BitVector scratch;
+
+  void build();
+  void numberVars();
+  unsigned numberVar(const Pointee &var);
+  void addDEFBits(InsInfo *ii, unsigned id);
+  bool addRC(InsInfo *ii, const Pointee &var) {
+    return ii->addRC(numberVar(var));
+  }
+
   static bool sameValues(const Pointee &val1, const Pointee &val2);
+  static bool coversValue(const Pointee &def, const Pointee &val);
   void crawlBasicBlock(const llvm::BasicBlock *bb);
+  struct BlockInfo {
+    BlockInfo(const llvm::BasicBlock *bb) : bb(bb) {}
+
+    const llvm::BasicBlock *bb;
+    llvm::SmallVector<InsInfo *, 16> insns; /* bottom-up */
+    llvm::SmallVector<unsigned, 2> succs, preds; /* indices to blocks */
+  };
+  /* in post-order */
+  std::vector<BlockInfo> blocks;
+  unsigned long rcIterations, rcVisits;
+
+  void buildBlocks();
   bool computeRCi(InsInfo *insInfoi, InsInfo *insInfoj);
-  bool computeRCi(InsInfo *insInfoi);
   void computeRC();
 
-  void computeSCi(const llvm::Instruction *i, const llvm::Instruction *j);
+  void computeSCi(InsInfo *insInfoi, const InsInfo *insInfoj);
   void computeSC();
 
+  /*
+   * Branches (instruction numbers) block b is control dependent on, blocks
+   * numbered in the function order: ctrlDeps[ctrlBegin[b]] ..
+   * ctrlDeps[ctrlBegin[b + 1] - 1].
+   */
+  std::vector<unsigned> ctrlBegin, ctrlDeps;
+  bool controlDepsCached;
+
   bool computeBC();
-  bool updateRCSC(llvm::PostDominanceFrontier::DomSetType::const_iterator start,
-                  llvm::PostDominanceFrontier::DomSetType::const_iterator end);
+  bool updateRCSC(unsigned start, unsigned end);
 
   void dump();
 
-  InsInfo *getInsInfo(const llvm::Instruction *i) const {
-    InsInfoMap::const_iterator I = insInfoMap.find(i);
-    assert(I != insInfoMap.end());
+  unsigned getIndex(const llvm::Instruction *i) const {
+    assert(built && "InsInfos used before build()");
+    llvm::DenseMap<const llvm::Instruction *, unsigned>::const_iterator I =
+      insIndex.find(i);
+    assert(I != insIndex.end());
     return I->second;
   }
+  InsInfo *getInsInfo(const llvm::Instruction *i) {
+    return &insInfos[getIndex(i)];
+  }
+  const InsInfo *getInsInfo(const llvm::Instruction *i) const {
+    return &insInfos[getIndex(i)];
+  }
 
-  static void removeUndefBranches(ModulePass *MP, Function &F);
-  static void removeUndefCalls(ModulePass *MP, Function &F);
+  static void removeUndefBranches(PostDominatorTree &PDT, Function &F);
+  static void removeUndefCalls(Function &F);
+};
+
+/*
+ * A slicing criterion: the instruction is kept and var (unless null) is
+ * relevant there.
+ */
+struct Criterion {
+  Criterion(const llvm::Instruction *ins,
+            const llvm::ptr::PointsToSets::Pointee &var) : ins(ins), var(var) {}
+
+  const llvm::Instruction *ins;
+  llvm::ptr::PointsToSets::Pointee var;
 };
+typedef std::vector<Criterion> Criteria;
 
 bool findInitialCriterion(llvm::Function &F, FunctionStaticSlicer &ss,
                           bool startingFunction = false);
+/*
+ * The asserts and __ai_state_ stores of F, which findInitialCriterion adds
+ * all at once, as separate criteria.
+ */
+void findCriteria(const llvm::Function &F, Criteria &C);
+/* __ai_state_ variables are relevant at the returns of a starting function */
+void addStartingCriteria(const llvm::Function &F, FunctionStaticSlicer &ss);
 
 }}
 
@@ -20,6 +20,7 @@
 #include "llvm/Type.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 
+#include "../Cache/AnalysisPasses.h"
 #include "../Callgraph/Callgraph.h"
 #include "../PointsTo/PointsTo.h"
 
@@ -34,6 +35,10 @@ namespace {
 
       virtual bool runOnModule(Module &M);
 
+      virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+        AU.addRequired<cache::PointsToAnalysis>();
+      }
+
     private:
       static void replaceInsLoad(llvm::Function &F, llvm::CallInst *CI);
       static void replaceInsStore(llvm::Function &F, llvm::CallInst *CI);
@@ -256,7 +261,7 @@ bool Prepare::addInitFun(const callgraph::Callgraph &CG,
   if (F.isDeclaration())
     return false;
   if (starting) {
-    callgraph::Callgraph::range_iterator callees = CG.callees(&F);
+    callgraph::Callgraph::closure_range callees = CG.callees(&F);
     if (std::distance(callees.first, callees.second))
       return false;
   }
@@ -286,11 +291,8 @@ void Prepare::findInitFuns(Module &M, const ptr::PointsToSets &PS) {
 }
 
 bool Prepare::runOnModule(Module &M) {
-  ptr::PointsToSets PS;
-  {
-    ptr::ProgramStructure P(M);
-    computePointsToSets(P, PS);
-  }
+  const ptr::PointsToSets &PS =
+    getAnalysis<cache::PointsToAnalysis>().getPointsToSets();
 
   deleteAsmBodies(M);
 
@@ -1,18 +1,69 @@
 // This file is distributed under the University of Illinois Open Source
 // License. See LICENSE.TXT for details.
 
+#include <set>
+
+#include "llvm/Constants.h"
 #include "llvm/Instructions.h"
 #include "llvm/Function.h"
+#include "llvm/Module.h"
 #include "llvm/Pass.h"
 #include "llvm/Value.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/InstIterator.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
 
 #include "FunctionStaticSlicer.h"
+#include "StaticSlicer.h"
+#include "../Cache/AnalysisPasses.h"
 #include "../Callgraph/Callgraph.h"
 #include "../Modifies/Modifies.h"
 #include "../PointsTo/PointsTo.h"
+#include "../Support/Json.h"
+#include "../Support/Parallel.h"
+#include "../Support/Stats.h"
+#include "../Support/Trace.h"
 
 using namespace llvm;
 
+static cl::opt<unsigned>
+SlicerThreads("slicer-threads",
+              cl::desc("Number of threads slicing the functions of one round "
+                       "(0 = number of CPUs)"),
+              cl::init(1));
+
+static cl::opt<bool>
+SlicerRounds("slicer-rounds",
+             cl::desc("Propagate criteria in rounds over all functions "
+                      "instead of over callgraph SCCs"));
+
+static cl::opt<std::string>
+SliceEachBitmap("slice-each-bitmap",
+                cl::desc("Write the instructions in the slice of every "
+                         "criterion to <file> as JSON (slice-each)"),
+                cl::value_desc("file"));
+
+static cl::opt<std::string>
+SliceEachModules("slice-each-modules",
+                 cl::desc("Write the slice of every criterion as module "
+                          "<prefix>.<n>.bc (slice-each)"),
+                 cl::value_desc("prefix"));
+
+static stats::Counter Recalculations("slicer.recalculations",
+    "Per-function slice calculations");
+static stats::Counter DuplicateCriteria("slicer.duplicate-criteria",
+    "Criteria sliced already");
+static stats::Counter WorklistRounds("slicer.worklist-rounds",
+    "Batches of functions sliced while propagating criteria");
+
 namespace llvm { namespace slicing { namespace detail {
 
     typedef ptr::PointsToSets::Pointee Pointee;
@@ -34,8 +85,8 @@ namespace llvm { namespace slicing { namespace detail {
     }
 
     static void getRelevantVarsAtCall(const CallInst *C, const Function *F,
-			       ValSet::const_iterator b,
-			       const ValSet::const_iterator &e,
+			       FunctionStaticSlicer::relevant_iterator b,
+			       const FunctionStaticSlicer::relevant_iterator &e,
 			       RelevantSet &out) {
 	assert(!isInlineAssembly(C) && "Inline assembly is not supported!");
 
@@ -52,8 +103,8 @@ namespace llvm { namespace slicing { namespace detail {
     }
 
     static void getRelevantVarsAtExit(const CallInst *C, const ReturnInst *R,
-			       ValSet::const_iterator b,
-			       const ValSet::const_iterator &e,
+			       FunctionStaticSlicer::relevant_iterator b,
+			       const FunctionStaticSlicer::relevant_iterator &e,
 			       RelevantSet &out) {
 	assert(!isInlineAssembly(C) && "Inline assembly is not supported!");
 
@@ -81,52 +132,12 @@ namespace llvm { namespace slicing { namespace detail {
 
 namespace llvm { namespace slicing {
 
-    class StaticSlicer {
-    public:
-        typedef std::map<llvm::Function const*, FunctionStaticSlicer *> Slicers;
-        typedef std::multimap<llvm::Function const*,llvm::CallInst const*>
-                FuncsToCalls;
-        typedef std::multimap<llvm::CallInst const*,llvm::Function const*>
-                CallsToFuncs;
-
-        StaticSlicer(ModulePass *MP, Module &M,
-		     const ptr::PointsToSets &PS,
-                     const callgraph::Callgraph &CG,
-                     const mods::Modifies &MOD);
-
-        ~StaticSlicer();
-
-        void computeSlice();
-        bool sliceModule();
-
-    private:
-        typedef llvm::SmallVector<const llvm::Function *, 20> InitFuns;
-
-	void buildDicts(const ptr::PointsToSets &PS, const CallInst *c);
-        void buildDicts(const ptr::PointsToSets &PS);
-
-        template<typename OutIterator>
-        void emitToCalls(llvm::Function const* const f, OutIterator out);
-
-        template<typename OutIterator>
-        void emitToExits(llvm::Function const* const f, OutIterator out);
-
-        void runFSS(Function &F, const ptr::PointsToSets &PS,
-                    const callgraph::Callgraph &CG, const mods::Modifies &MOD);
-
-        ModulePass *MP;
-        Module &module;
-        Slicers slicers;
-        InitFuns initFuns;
-        FuncsToCalls funcsToCalls;
-        CallsToFuncs callsToFuncs;
-    };
-
     template<typename OutIterator>
     void StaticSlicer::emitToCalls(const Function *f, OutIterator out) {
 	const Instruction *entry = getFunctionEntry(f);
-	const ValSet::const_iterator relBgn = slicers[f]->relevant_begin(entry);
-        const ValSet::const_iterator relEnd = slicers[f]->relevant_end(entry);
+	typedef FunctionStaticSlicer::relevant_iterator RelIt;
+	const RelIt relBgn = slicers[f]->relevant_begin(entry);
+        const RelIt relEnd = slicers[f]->relevant_end(entry);
 
         FuncsToCalls::const_iterator c, e;
         llvm::tie(c, e) = funcsToCalls.equal_range(f);
@@ -155,9 +166,9 @@ namespace llvm { namespace slicing {
         getFunctionCalls(f, std::back_inserter(C));
 
         for (CallsVec::const_iterator c = C.begin(); c != C.end(); ++c) {
-	    const ValSet::const_iterator relBgn =
+	    const FunctionStaticSlicer::relevant_iterator relBgn =
                 slicers[f]->relevant_begin(getSuccInBlock(*c));
-            const ValSet::const_iterator relEnd =
+            const FunctionStaticSlicer::relevant_iterator relEnd =
                 slicers[f]->relevant_end(getSuccInBlock(*c));
 
             CallsToFuncs::const_iterator g, e;
@@ -216,12 +227,15 @@ namespace llvm { namespace slicing {
     StaticSlicer::StaticSlicer(ModulePass *MP, Module &M,
                                const ptr::PointsToSets &PS,
                                const callgraph::Callgraph &CG,
-                               const mods::Modifies &MOD) : MP(MP), module(M),
-                               slicers(), initFuns(), funcsToCalls(),
-                               callsToFuncs() {
+                               const mods::Modifies &MOD,
+                               bool initialCriteria) : MP(MP), module(M),
+                               CG(CG), slicers(), initFuns(), funcsToCalls(),
+                               callsToFuncs(), recalculations(0),
+                               sliceThreads(SlicerThreads),
+                               sliceRounds(SlicerRounds) {
         for (Module::iterator f = M.begin(); f != M.end(); ++f)
           if (!f->isDeclaration() && !memoryManStuff(&*f))
-            runFSS(*f, PS, CG, MOD);
+            runFSS(*f, PS, CG, MOD, initialCriteria);
         buildDicts(PS);
     }
 
@@ -233,12 +247,18 @@ namespace llvm { namespace slicing {
 
     void StaticSlicer::runFSS(Function &F, const ptr::PointsToSets &PS,
 			      const callgraph::Callgraph &CG,
-			      const mods::Modifies &MOD) {
-      callgraph::Callgraph::range_iterator callees = CG.callees(&F);
+			      const mods::Modifies &MOD,
+			      bool initialCriteria) {
+      callgraph::Callgraph::closure_range callees = CG.callees(&F);
       bool starting = std::distance(callees.first, callees.second) == 0;
 
+      trace::Scope T("slicer.construct", F.getName());
       FunctionStaticSlicer *FSS = new FunctionStaticSlicer(F, MP, PS, MOD);
-      bool hadAssert = slicing::findInitialCriterion(F, *FSS, starting);
+      bool hadAssert = false;
+      if (initialCriteria)
+        hadAssert = slicing::findInitialCriterion(F, *FSS, starting);
+      else if (starting)
+        slicing::addStartingCriteria(F, *FSS);
 
       /*
        * Functions with an assert might not have a return and slicer wouldn't
@@ -250,13 +270,130 @@ namespace llvm { namespace slicing {
       slicers.insert(Slicers::value_type(&F, FSS));
     }
 
+    /*
+     * Every function of a round has its own slicer, so they are sliced
+     * independently. Only the pass manager is shared, the control
+     * dependences are fetched before. Propagating the criteria stays serial
+     * in computeSlice in the order of Q, so the result is the same as with
+     * one thread.
+     */
+    void StaticSlicer::calculateParallel(const WorkSet &Q, unsigned threads) {
+        std::vector<FunctionStaticSlicer *> FSS;
+        SmallPtrSet<const Function *, 20> seen;
+
+        for (WorkSet::const_iterator f = Q.begin(); f != Q.end(); ++f)
+            if (seen.insert(*f)) {
+                FunctionStaticSlicer *S = slicers[*f];
+                S->cacheControlDeps();
+                FSS.push_back(S);
+            }
+
+        /* statistics have to be registered under a lock */
+        if (!llvm_is_multithreaded())
+            llvm_start_multithreaded();
+
+        parallel::parallelFor(FSS.size(), threads, [&](unsigned I) {
+            FSS[I]->calculateStaticSlice();
+        });
+
+        recalculations += FSS.size();
+        Recalculations.add(FSS.size());
+    }
+
+    void StaticSlicer::calculate(const WorkSet &Q, unsigned threads) {
+        trace::Scope T("slicer.round", utostr(Q.size()) + " functions");
+
+        touched.insert(Q.begin(), Q.end());
+
+        if (threads > 1) {
+            calculateParallel(Q, threads);
+            return;
+        }
+
+        for (WorkSet::const_iterator f = Q.begin(); f != Q.end(); ++f) {
+            slicers[*f]->calculateStaticSlice();
+            ++recalculations;
+            ++Recalculations;
+        }
+    }
+
     void StaticSlicer::computeSlice() {
-        typedef SmallVector<const Function *, 20> WorkSet;
-        WorkSet Q(initFuns);
+        computeSlice(initFuns);
+    }
+
+    void StaticSlicer::computeSlice(const WorkSet &start) {
+        unsigned threads = sliceThreads;
+
+        if (!threads)
+            threads = parallel::hardwareThreads();
+
+        if (sliceRounds)
+            computeSliceRounds(start, threads);
+        else
+            computeSliceSCC(start, threads);
+    }
+
+    /*
+     * Criteria go up to the callers (emitToCalls) and down to the callees
+     * (emitToExits). The SCCs of the callgraph are swept alternately
+     * bottom-up and top-down until nothing is pending. SCCs of the same
+     * height never call each other, so all pending functions of a height
+     * are calculated together and the height is iterated to a fixpoint (that
+     * matters for recursion only) before moving on. A function outside of
+     * recursion is thus mostly calculated once per direction.
+     */
+    void StaticSlicer::computeSliceSCC(const WorkSet &start,
+                                       unsigned threads) {
+        typedef std::vector<WorkSet> Heights;
+        typedef std::set<const Function *> Pending;
+        const callgraph::Callgraph::SCCList &SCCs = CG.getSCCs();
+        Heights heights;
+
+        for (unsigned s = 0; s < SCCs.size(); ++s) {
+            unsigned h = CG.getSCCHeight(s);
+            if (heights.size() <= h)
+                heights.resize(h + 1);
+            heights[h].append(SCCs[s].begin(), SCCs[s].end());
+        }
+
+        Pending pending(start.begin(), start.end());
+        bool up = true;
+
+        while (!pending.empty()) {
+            for (unsigned k = 0; k < heights.size(); ++k) {
+                const WorkSet &H = heights[up ? k : heights.size() - 1 - k];
+
+                while (true) {
+                    WorkSet Q;
+                    for (WorkSet::const_iterator f = H.begin(); f != H.end();
+                         ++f)
+                        if (pending.erase(*f))
+                            Q.push_back(*f);
+
+                    if (Q.empty())
+                        break;
+
+                    ++WorklistRounds;
+                    calculate(Q, threads);
+
+                    for (WorkSet::const_iterator f = Q.begin(); f != Q.end();
+                         ++f) {
+                        emitToCalls(*f, std::inserter(pending, pending.end()));
+                        emitToExits(*f, std::inserter(pending, pending.end()));
+                    }
+                }
+            }
+            up = !up;
+        }
+    }
+
+    void StaticSlicer::computeSliceRounds(const WorkSet &start,
+                                          unsigned threads) {
+        WorkSet Q(start);
 
         while (!Q.empty()) {
-            for (WorkSet::const_iterator f = Q.begin(); f != Q.end(); ++f)
-                slicers[*f]->calculateStaticSlice();
+            ++WorklistRounds;
+            calculate(Q, threads);
 
             WorkSet tmp;
             for (WorkSet::const_iterator f = Q.begin(); f != Q.end(); ++f) {
@@ -267,7 +404,79 @@ namespace llvm { namespace slicing {
         }
     }
 
+    void StaticSlicer::getMembership(BitVector &bits, unsigned size) const {
+        unsigned k = 0;
+
+        bits.clear();
+        bits.resize(size);
+        for (Module::const_iterator f = module.begin(); f != module.end(); ++f) {
+            if (f->isDeclaration())
+                continue;
+            Slicers::const_iterator s = slicers.find(&*f);
+            for (const_inst_iterator I = inst_begin(*f), E = inst_end(*f);
+                 I != E; ++I, ++k)
+                if (s == slicers.end() || s->second->inSlice(&*I))
+                    bits.set(k);
+        }
+    }
+
+    void StaticSlicer::computeSlices(const Criteria &C,
+                                     std::vector<BitVector> &slices) {
+        typedef std::map<const Function *, FunctionStaticSlicer::State> States;
+        typedef std::pair<const Instruction *, detail::Pointee> Key;
+        typedef std::map<Key, unsigned> Seen;
+        States base;
+        Seen seen;
+        unsigned size = 0;
+
+        for (Module::const_iterator f = module.begin(); f != module.end(); ++f)
+            if (!f->isDeclaration())
+                size += std::distance(inst_begin(*f), inst_end(*f));
+
+        computeSlice();
+        for (Slicers::const_iterator s = slicers.begin(); s != slicers.end();
+             ++s)
+            s->second->saveState(base[s->first]);
+        touched.clear();
+
+        slices.assign(C.size(), BitVector());
+        for (unsigned c = 0; c < C.size(); ++c) {
+            const Criterion &crit = C[c];
+            const Function *F = crit.ins->getParent()->getParent();
+
+            std::pair<Seen::iterator, bool> dup =
+                seen.insert(Seen::value_type(Key(crit.ins, crit.var), c));
+            if (!dup.second) {
+                slices[c] = slices[dup.first->second];
+                ++DuplicateCriteria;
+                continue;
+            }
+
+            trace::Scope T("slicer.criterion", F->getName());
+
+            for (std::set<const Function *>::const_iterator f =
+                 touched.begin(); f != touched.end(); ++f)
+                slicers[*f]->restoreState(base[*f]);
+            touched.clear();
+
+            Slicers::const_iterator s = slicers.find(F);
+            if (s != slicers.end()) {
+                WorkSet start;
+                start.push_back(F);
+                s->second->addInitialCriterion(crit.ins, crit.var);
+                computeSlice(start);
+            }
+            getMembership(slices[c], size);
+        }
+
+        for (std::set<const Function *>::const_iterator f = touched.begin();
+             f != touched.end(); ++f)
+            slicers[*f]->restoreState(base[*f]);
+        touched.clear();
+    }
+
     bool StaticSlicer::sliceModule() {
+      trace::Scope T("slicer.slice-module");
       bool modified = false;
       for (Slicers::iterator s = slicers.begin(); s != slicers.end(); ++s)
         modified |= s->second->slice();
@@ -291,6 +500,9 @@ namespace {
       void getAnalysisUsage(AnalysisUsage &AU) const {
         AU.addRequired<PostDominatorTree>();
         AU.addRequired<PostDominanceFrontier>();
+        AU.addRequired<cache::PointsToAnalysis>();
+        AU.addRequired<cache::CallgraphAnalysis>();
+        AU.addRequired<cache::ModifiesAnalysis>();
       }
   };
 }
@@ -299,21 +511,161 @@ static RegisterPass<Slicer> X("slice-inter", "Slices the code interprocedurally"
 char Slicer::ID;
 
 bool Slicer::runOnModule(Module &M) {
-  ptr::PointsToSets PS;
-  {
-    ptr::ProgramStructure P(M);
-    computePointsToSets(P, PS);
+  trace::Scope T("slice-inter");
+  const ptr::PointsToSets &PS =
+    getAnalysis<cache::PointsToAnalysis>().getPointsToSets();
+  const callgraph::Callgraph &CG =
+    getAnalysis<cache::CallgraphAnalysis>().getCallgraph();
+  const mods::Modifies &MOD =
+    getAnalysis<cache::ModifiesAnalysis>().getModifies();
+
+  slicing::StaticSlicer SS(this, M, PS, CG, MOD);
+  SS.computeSlice();
+  return SS.sliceModule();
+}
+
+namespace {
+  class SliceEach : public ModulePass {
+    public:
+      static char ID;
+
+      SliceEach() : ModulePass(ID) {}
+
+      virtual bool runOnModule(Module &M);
+
+      void getAnalysisUsage(AnalysisUsage &AU) const {
+        AU.addRequired<PostDominanceFrontier>();
+        AU.addRequired<cache::PointsToAnalysis>();
+        AU.addRequired<cache::CallgraphAnalysis>();
+        AU.addRequired<cache::ModifiesAnalysis>();
+        AU.setPreservesAll();
+      }
+  };
+}
+
+static RegisterPass<SliceEach> Y("slice-each",
+    "Computes a separate slice for every assert and __ai_state_ store");
+char SliceEach::ID;
+
+/* bit k of the bitmap is bit k % 4 of hex digit k / 4 */
+static void writeBits(raw_ostream &OS, const BitVector &bits) {
+  static const char digits[] = "0123456789abcdef";
+
+  for (unsigned k = 0; k < bits.size(); k += 4) {
+    unsigned d = 0;
+    for (unsigned b = 0; b < 4 && k + b < bits.size(); ++b)
+      if (bits.test(k + b))
+        d |= 1 << b;
+    OS << digits[d];
   }
+}
 
-  callgraph::Callgraph CG(M, PS);
+static bool writeBitmap(const std::string &path, const slicing::Criteria &C,
+                        const std::vector<BitVector> &slices,
+                        const DenseMap<const Instruction *, unsigned> &index,
+                        unsigned size) {
+  std::string err;
+  raw_fd_ostream OS(path.c_str(), err);
+  if (!err.empty()) {
+    errs() << "ERROR: cannot write " << path << ": " << err << '\n';
+    return false;
+  }
 
-  mods::Modifies MOD;
-  {
-    mods::ProgramStructure P1(M);
-    computeModifies(P1, CG, PS, MOD);
+  OS << "{\n  \"instructions\": " << size << ",\n  \"criteria\": [";
+  for (unsigned c = 0; c < C.size(); ++c) {
+    const Instruction *ins = C[c].ins;
+    OS << (c ? ",\n" : "\n") << "    { \"function\": ";
+    json::writeString(OS, ins->getParent()->getParent()->getName());
+    OS << ", \"instruction\": " << index.lookup(ins) << ", \"kept\": " <<
+      slices[c].count() << ", \"bits\": \"";
+    writeBits(OS, slices[c]);
+    OS << "\" }";
   }
+  OS << "\n  ]\n}\n";
+  return true;
+}
 
-  slicing::StaticSlicer SS(this, M, PS, CG, MOD);
-  SS.computeSlice();
-  return SS.sliceModule();
+/*
+ * Removes the instructions not in bits from a copy of M, the way sliceModule
+ * does, and writes the copy to path.
+ */
+static bool writeSlicedModule(const Module &M, const BitVector &bits,
+                              const std::string &path) {
+  ValueToValueMapTy VMap;
+  OwningPtr<Module> Clone(CloneModule(&M, VMap));
+  std::vector<Instruction *> removed;
+  unsigned k = 0;
+
+  for (Module::const_iterator f = M.begin(); f != M.end(); ++f)
+    if (!f->isDeclaration())
+      for (const_inst_iterator I = inst_begin(*f), E = inst_end(*f); I != E;
+           ++I, ++k)
+        if (!bits.test(k))
+          removed.push_back(cast<Instruction>((Value *)VMap[&*I]));
+
+  for (std::vector<Instruction *>::const_iterator I = removed.begin(),
+       E = removed.end(); I != E; ++I)
+    (*I)->replaceAllUsesWith(UndefValue::get((*I)->getType()));
+  for (std::vector<Instruction *>::const_iterator I = removed.begin(),
+       E = removed.end(); I != E; ++I)
+    (*I)->eraseFromParent();
+
+  for (Module::iterator f = Clone->begin(); f != Clone->end(); ++f)
+    if (!f->isDeclaration()) {
+      PostDominatorTree PDT;
+      PDT.runOnFunction(*f);
+      slicing::FunctionStaticSlicer::removeUndefs(PDT, *f);
+    }
+
+  std::string err;
+  raw_fd_ostream OS(path.c_str(), err, raw_fd_ostream::F_Binary);
+  if (!err.empty()) {
+    errs() << "ERROR: cannot write " << path << ": " << err << '\n';
+    return false;
+  }
+  WriteBitcodeToFile(Clone.get(), OS);
+  return true;
+}
+
+bool SliceEach::runOnModule(Module &M) {
+  trace::Scope T("slice-each");
+  const ptr::PointsToSets &PS =
+    getAnalysis<cache::PointsToAnalysis>().getPointsToSets();
+  const callgraph::Callgraph &CG =
+    getAnalysis<cache::CallgraphAnalysis>().getCallgraph();
+  const mods::Modifies &MOD =
+    getAnalysis<cache::ModifiesAnalysis>().getModifies();
+
+  slicing::Criteria C;
+  DenseMap<const Instruction *, unsigned> index;
+  unsigned size = 0;
+
+  for (Module::const_iterator f = M.begin(); f != M.end(); ++f) {
+    if (f->isDeclaration())
+      continue;
+    if (!memoryManStuff(&*f))
+      slicing::findCriteria(*f, C);
+    for (const_inst_iterator I = inst_begin(*f), E = inst_end(*f); I != E; ++I)
+      index[&*I] = size++;
+  }
+
+  slicing::StaticSlicer SS(this, M, PS, CG, MOD, false);
+  std::vector<BitVector> slices;
+  SS.computeSlices(C, slices);
+
+  if (!SliceEachBitmap.empty())
+    writeBitmap(SliceEachBitmap, C, slices, index, size);
+
+  if (!SliceEachModules.empty())
+    for (unsigned c = 0; c < C.size(); ++c)
+      writeSlicedModule(M, slices[c],
+                        SliceEachModules + "." + utostr(c) + ".bc");
+
+  if (SliceEachBitmap.empty() && SliceEachModules.empty())
+    for (unsigned c = 0; c < C.size(); ++c)
+      errs() << "criterion " << c << " in " <<
+        C[c].ins->getParent()->getParent()->getName() << ": " <<
+        slices[c].count() << " of " << size << " instructions\n";
+
+  return false;
 }
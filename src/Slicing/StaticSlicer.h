@@ -0,0 +1,108 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#ifndef SLICING_STATICSLICER_H
+#define SLICING_STATICSLICER_H
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "llvm/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/SmallVector.h"
+
+#include "FunctionStaticSlicer.h"
+#include "../Callgraph/Callgraph.h"
+#include "../Modifies/Modifies.h"
+#include "../PointsTo/PointsTo.h"
+
+namespace llvm { namespace slicing {
+
+    class StaticSlicer {
+    public:
+        typedef std::map<llvm::Function const*, FunctionStaticSlicer *> Slicers;
+        typedef std::multimap<llvm::Function const*,llvm::CallInst const*>
+                FuncsToCalls;
+        typedef std::multimap<llvm::CallInst const*,llvm::Function const*>
+                CallsToFuncs;
+
+        /*
+         * Without initialCriteria, only the returns of starting functions
+         * get their criteria (see addStartingCriteria) and the rest is up
+         * to computeSlices.
+         */
+        StaticSlicer(ModulePass *MP, Module &M,
+		     const ptr::PointsToSets &PS,
+                     const callgraph::Callgraph &CG,
+                     const mods::Modifies &MOD,
+                     bool initialCriteria = true);
+
+        ~StaticSlicer();
+
+        void computeSlice();
+        bool sliceModule();
+
+        /*
+         * Computes a separate slice for every criterion in C and leaves the
+         * module as it is. Bit k of slices[c] is set if the k-th instruction
+         * of the module (of the defined functions in order, as inst_iterator
+         * walks them) is in the slice of C[c].
+         *
+         * The analyses and the DEF/REF sets are shared by all the slices.
+         * The criteria of the constructor are part of every slice, so their
+         * fixpoint is computed once and each criterion continues from it.
+         * Only functions touched by the previous criterion are reset.
+         */
+        void computeSlices(const Criteria &C, std::vector<BitVector> &slices);
+
+        /* threads slicing a batch of functions, -slicer-threads by default */
+        void setThreads(unsigned threads) { sliceThreads = threads; }
+        /* rounds over all functions or SCCs, -slicer-rounds by default */
+        void setRounds(bool rounds) { sliceRounds = rounds; }
+
+        /* how many times was a function's slice calculated */
+        unsigned long getRecalculations() const { return recalculations; }
+
+    private:
+        typedef llvm::SmallVector<const llvm::Function *, 20> InitFuns;
+        typedef llvm::SmallVector<const llvm::Function *, 20> WorkSet;
+
+        void calculate(const WorkSet &Q, unsigned threads);
+        void calculateParallel(const WorkSet &Q, unsigned threads);
+        void computeSlice(const WorkSet &start);
+        void computeSliceRounds(const WorkSet &start, unsigned threads);
+        void computeSliceSCC(const WorkSet &start, unsigned threads);
+        void getMembership(BitVector &bits, unsigned size) const;
+
+	void buildDicts(const ptr::PointsToSets &PS, const CallInst *c);
+        void buildDicts(const ptr::PointsToSets &PS);
+
+        template<typename OutIterator>
+        void emitToCalls(llvm::Function const* const f, OutIterator out);
+
+        template<typename OutIterator>
+        void emitToExits(llvm::Function const* const f, OutIterator out);
+
+        void runFSS(Function &F, const ptr::PointsToSets &PS,
+                    const callgraph::Callgraph &CG, const mods::Modifies &MOD,
+                    bool initialCriteria);
+
+        ModulePass *MP;
+        Module &module;
+        const callgraph::Callgraph &CG;
+        Slicers slicers;
+        InitFuns initFuns;
+        FuncsToCalls funcsToCalls;
+        CallsToFuncs callsToFuncs;
+        /* functions calculated since computeSlices reset them last time */
+        std::set<const llvm::Function *> touched;
+        unsigned long recalculations;
+        unsigned sliceThreads;
+        bool sliceRounds;
+    };
+
+}}
+
+#endif
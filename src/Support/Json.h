@@ -0,0 +1,21 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#ifndef SUPPORT_JSON_H
+#define SUPPORT_JSON_H
+
+#include "llvm/ADT/StringRef.h"
+
+namespace llvm {
+  class raw_ostream;
+}
+
+namespace llvm { namespace json {
+
+  // Writes S as a quoted JSON string. Quotes, backslashes and control
+  // characters are escaped, other bytes (UTF-8 included) go as they are.
+  void writeString(raw_ostream &OS, StringRef S);
+
+}}
+
+#endif
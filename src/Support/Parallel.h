@@ -0,0 +1,48 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#ifndef SUPPORT_PARALLEL_H
+#define SUPPORT_PARALLEL_H
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace llvm { namespace parallel {
+
+  // Calls fn(I) for every I in [0, N) on up to Threads threads. Indices are
+  // handed out one by one, so the order of the calls is unspecified and fn
+  // must not touch data of other indices.
+  template<typename Fn>
+  void parallelFor(unsigned N, unsigned Threads, Fn fn) {
+    if (Threads > N)
+      Threads = N;
+
+    if (Threads <= 1) {
+      for (unsigned I = 0; I < N; ++I)
+        fn(I);
+      return;
+    }
+
+    std::atomic<unsigned> Next(0);
+    std::vector<std::thread> Workers;
+
+    for (unsigned T = 0; T < Threads; ++T)
+      Workers.push_back(std::thread([&]() {
+        for (unsigned I = Next++; I < N; I = Next++)
+          fn(I);
+      }));
+
+    for (unsigned T = 0; T < Workers.size(); ++T)
+      Workers[T].join();
+  }
+
+  // number of hardware threads, at least 1
+  static inline unsigned hardwareThreads() {
+    unsigned N = std::thread::hardware_concurrency();
+    return N ? N : 1;
+  }
+
+}}
+
+#endif
@@ -0,0 +1,137 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "Json.h"
+#include "Stats.h"
+
+using namespace llvm;
+using namespace llvm::stats;
+
+static cl::opt<std::string>
+StatsJSON("slicer-stats-json",
+          cl::desc("Count what the analyses do and write it as JSON to the "
+                   "file at exit"),
+          cl::value_desc("filename"));
+
+namespace {
+  // Never destroyed, counters of other files may still be updated while
+  // static objects are torn down.
+  struct Registry {
+    std::vector<const Counter *> Counters;
+    std::vector<const KeyedCounter *> KeyedCounters;
+    std::vector<const Histogram *> Histograms;
+  };
+
+  Registry &getRegistry() {
+    static Registry *R = new Registry;
+    return *R;
+  }
+
+  void dumpJSON() {
+    const Registry &R = getRegistry();
+    std::string Err;
+    raw_fd_ostream OS(StatsJSON.c_str(), Err);
+
+    if (!Err.empty()) {
+      errs() << "WARNING[Stats]: cannot write " << StatsJSON << ": " << Err <<
+        '\n';
+      return;
+    }
+
+    OS << "{\n  \"counters\": {";
+    for (unsigned I = 0; I < R.Counters.size(); ++I) {
+      OS << (I ? ",\n    " : "\n    ");
+      json::writeString(OS, R.Counters[I]->getName());
+      OS << ": " << R.Counters[I]->get();
+    }
+
+    OS << "\n  },\n  \"keyed\": {";
+    for (unsigned I = 0; I < R.KeyedCounters.size(); ++I) {
+      const KeyedCounter *C = R.KeyedCounters[I];
+
+      OS << (I ? ",\n    " : "\n    ");
+      json::writeString(OS, C->getName());
+      OS << ": {";
+      for (unsigned K = 0; K < C->getNumKeys(); ++K) {
+        OS << (K ? ", " : " ");
+        json::writeString(OS, C->getKey(K));
+        OS << ": " << C->get(K);
+      }
+      OS << " }";
+    }
+
+    OS << "\n  },\n  \"histograms\": {";
+    for (unsigned I = 0; I < R.Histograms.size(); ++I) {
+      const Histogram *H = R.Histograms[I];
+
+      OS << (I ? ",\n    " : "\n    ");
+      json::writeString(OS, H->getName());
+      OS << ": { \"count\": " << H->getCount() << ", \"sum\": " <<
+        H->getSum() << ", \"max\": " << H->getMax() << ", \"buckets\": [";
+
+      /* [lower bound, count] of the non-empty buckets */
+      bool First = true;
+      for (unsigned B = 0; B < Histogram::BUCKETS; ++B) {
+        uint64_t N = H->getBucket(B);
+        if (!N)
+          continue;
+        OS << (First ? "" : ", ") << '[' << (B ? 1ULL << (B - 1) : 0ULL) <<
+          ", " << N << ']';
+        First = false;
+      }
+      OS << "] }";
+    }
+
+    OS << "\n  }\n}\n";
+  }
+}
+
+bool stats::initEnabled() {
+  if (StatsJSON.empty())
+    return false;
+
+  std::atexit(dumpJSON);
+  return true;
+}
+
+Counter::Counter(const char *Name, const char *Desc) :
+    Name(Name), Desc(Desc), Value(0) {
+  getRegistry().Counters.push_back(this);
+}
+
+KeyedCounter::KeyedCounter(const char *Name, const char *Desc,
+                           const char *const *Keys, unsigned NumKeys) :
+    Name(Name), Desc(Desc), Keys(Keys),
+    NumKeys(NumKeys < MAX_KEYS ? NumKeys : MAX_KEYS) {
+  for (unsigned I = 0; I < MAX_KEYS; ++I)
+    Values[I].store(0, std::memory_order_relaxed);
+  getRegistry().KeyedCounters.push_back(this);
+}
+
+Histogram::Histogram(const char *Name, const char *Desc) :
+    Name(Name), Desc(Desc), Count(0), Sum(0), Max(0) {
+  for (unsigned I = 0; I < BUCKETS; ++I)
+    Buckets[I].store(0, std::memory_order_relaxed);
+  getRegistry().Histograms.push_back(this);
+}
+
+void Histogram::record(uint64_t V) {
+  unsigned B = 0;
+  for (uint64_t T = V; T; T >>= 1)
+    ++B;
+
+  Buckets[B].fetch_add(1, std::memory_order_relaxed);
+  Count.fetch_add(1, std::memory_order_relaxed);
+  Sum.fetch_add(V, std::memory_order_relaxed);
+
+  uint64_t M = Max.load(std::memory_order_relaxed);
+  while (V > M && !Max.compare_exchange_weak(M, V))
+    ;
+}
@@ -0,0 +1,101 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#ifndef SUPPORT_STATS_H
+#define SUPPORT_STATS_H
+
+#include <atomic>
+#include <stdint.h>
+
+namespace llvm { namespace stats {
+
+  // Whether -slicer-stats-json= was given. Nothing is counted otherwise, so
+  // a disabled counter costs one predictable branch.
+  bool initEnabled();
+  inline bool enabled() {
+    static const bool Enabled = initEnabled();
+    return Enabled;
+  }
+
+  // Counters are meant to be globals, they register themselves and are
+  // written out at exit. They can be updated from several threads.
+  class Counter {
+  public:
+    Counter(const char *Name, const char *Desc);
+
+    void add(uint64_t N = 1) {
+      if (enabled())
+        Value.fetch_add(N, std::memory_order_relaxed);
+    }
+    Counter &operator++() { add(); return *this; }
+
+    const char *getName() const { return Name; }
+    const char *getDesc() const { return Desc; }
+    uint64_t get() const { return Value.load(std::memory_order_relaxed); }
+
+  private:
+    const char *Name, *Desc;
+    std::atomic<uint64_t> Value;
+  };
+
+  // A counter per key of a small fixed set, e.g. kinds of rules.
+  class KeyedCounter {
+  public:
+    static const unsigned MAX_KEYS = 32;
+
+    KeyedCounter(const char *Name, const char *Desc,
+                 const char *const *Keys, unsigned NumKeys);
+
+    void add(unsigned Key, uint64_t N = 1) {
+      if (enabled() && Key < NumKeys)
+        Values[Key].fetch_add(N, std::memory_order_relaxed);
+    }
+
+    const char *getName() const { return Name; }
+    const char *getDesc() const { return Desc; }
+    unsigned getNumKeys() const { return NumKeys; }
+    const char *getKey(unsigned I) const { return Keys[I]; }
+    uint64_t get(unsigned I) const {
+      return Values[I].load(std::memory_order_relaxed);
+    }
+
+  private:
+    const char *Name, *Desc;
+    const char *const *Keys;
+    unsigned NumKeys;
+    std::atomic<uint64_t> Values[MAX_KEYS];
+  };
+
+  // Distribution of values in power-of-two buckets: bucket 0 counts zeros,
+  // bucket B values in [2^(B-1), 2^B).
+  class Histogram {
+  public:
+    static const unsigned BUCKETS = 65;
+
+    Histogram(const char *Name, const char *Desc);
+
+    void add(uint64_t V) {
+      if (enabled())
+        record(V);
+    }
+
+    const char *getName() const { return Name; }
+    const char *getDesc() const { return Desc; }
+    uint64_t getBucket(unsigned B) const {
+      return Buckets[B].load(std::memory_order_relaxed);
+    }
+    uint64_t getCount() const { return Count.load(std::memory_order_relaxed); }
+    uint64_t getSum() const { return Sum.load(std::memory_order_relaxed); }
+    uint64_t getMax() const { return Max.load(std::memory_order_relaxed); }
+
+  private:
+    void record(uint64_t V);
+
+    const char *Name, *Desc;
+    std::atomic<uint64_t> Buckets[BUCKETS];
+    std::atomic<uint64_t> Count, Sum, Max;
+  };
+
+}}
+
+#endif
@@ -0,0 +1,139 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/MutexGuard.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "Json.h"
+#include "Trace.h"
+
+using namespace llvm;
+using namespace llvm::trace;
+
+static cl::opt<std::string>
+TraceFile("slicer-trace",
+          cl::desc("Time the phases of the analyses and write them to the "
+                   "file at exit as a Chrome trace"),
+          cl::value_desc("filename"));
+
+namespace {
+  struct Event {
+    const char *Name;
+    std::string Detail;
+    uint64_t Begin, Duration;
+    unsigned Thread;
+  };
+
+  // Never destroyed, see Stats.cpp.
+  struct Recorder {
+    Recorder() : Epoch(std::chrono::steady_clock::now()) {}
+
+    sys::Mutex Lock;
+    std::chrono::steady_clock::time_point Epoch;
+    std::map<std::thread::id, unsigned> Threads;
+    std::vector<Event> Events;
+    Totals Sums;
+  };
+
+  bool CollectOnly;
+
+  Recorder &getRecorder() {
+    static Recorder *R = new Recorder;
+    return *R;
+  }
+
+  /* microseconds since the recorder was created */
+  uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - getRecorder().Epoch).count();
+  }
+
+  void dumpTrace() {
+    Recorder &R = getRecorder();
+    MutexGuard Guard(R.Lock);
+    std::string Err;
+    raw_fd_ostream OS(TraceFile.c_str(), Err);
+
+    if (!Err.empty()) {
+      errs() << "WARNING[Trace]: cannot write " << TraceFile << ": " << Err <<
+        '\n';
+      return;
+    }
+
+    OS << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    for (unsigned I = 0; I < R.Events.size(); ++I) {
+      const Event &E = R.Events[I];
+
+      OS << (I ? ",\n" : "\n") << "{\"name\": ";
+      json::writeString(OS, E.Name);
+      OS << ", \"cat\": \"slicer\", \"ph\": \"X\", \"ts\": " << E.Begin <<
+        ", \"dur\": " << E.Duration << ", \"pid\": 1, \"tid\": " << E.Thread;
+      if (!E.Detail.empty()) {
+        OS << ", \"args\": {\"detail\": ";
+        json::writeString(OS, E.Detail);
+        OS << '}';
+      }
+      OS << '}';
+    }
+    OS << "\n]}\n";
+  }
+}
+
+bool trace::initEnabled() {
+  if (TraceFile.empty())
+    return CollectOnly;
+
+  getRecorder();
+  std::atexit(dumpTrace);
+  return true;
+}
+
+void trace::collectTotals() {
+  CollectOnly = true;
+  getRecorder();
+}
+
+Totals trace::takeTotals() {
+  Recorder &R = getRecorder();
+  MutexGuard Guard(R.Lock);
+  Totals T;
+
+  T.swap(R.Sums);
+  return T;
+}
+
+void Scope::start() {
+  Active = true;
+  Begin = now();
+}
+
+void Scope::finish() {
+  uint64_t End = now();
+  Recorder &R = getRecorder();
+  MutexGuard Guard(R.Lock);
+
+  R.Sums[Name] += End - Begin;
+  if (TraceFile.empty())
+    return;
+
+  /* small thread numbers, in the order threads first finish a scope */
+  std::map<std::thread::id, unsigned>::iterator T =
+    R.Threads.insert(std::make_pair(std::this_thread::get_id(),
+                                    R.Threads.size())).first;
+
+  Event E;
+  E.Name = Name;
+  E.Detail.swap(Detail);
+  E.Begin = Begin;
+  E.Duration = End - Begin;
+  E.Thread = T->second;
+  R.Events.push_back(E);
+}
@@ -0,0 +1,67 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#ifndef SUPPORT_TRACE_H
+#define SUPPORT_TRACE_H
+
+#include <map>
+#include <stdint.h>
+#include <string>
+
+#include "llvm/ADT/StringRef.h"
+
+namespace llvm { namespace trace {
+
+  // Whether -slicer-trace= was given. The events are written at exit in the
+  // Chrome trace-event format (chrome://tracing, ui.perfetto.dev).
+  bool initEnabled();
+  inline bool enabled() {
+    static const bool Enabled = initEnabled();
+    return Enabled;
+  }
+
+  // Turns the scopes on without writing a trace, for tools which read the
+  // totals below. It has to be called before the first scope is entered.
+  void collectTotals();
+
+  // Time spent in finished scopes by name, in microseconds, since the last
+  // call. Time of nested scopes of the same name is counted for each one.
+  typedef std::map<std::string, uint64_t> Totals;
+  Totals takeTotals();
+
+  // Records the time between construction and destruction as one event of
+  // the calling thread. Detail (e.g. a function name) is shown as its
+  // argument. Scopes may nest and may be used from several threads.
+  class Scope {
+  public:
+    explicit Scope(const char *Name) : Name(Name), Active(false) {
+      if (enabled())
+        start();
+    }
+    Scope(const char *Name, StringRef Detail) : Name(Name), Active(false) {
+      if (enabled()) {
+        this->Detail = Detail.str();
+        start();
+      }
+    }
+    ~Scope() {
+      if (Active)
+        finish();
+    }
+
+  private:
+    Scope(const Scope &);
+    Scope &operator=(const Scope &);
+
+    void start();
+    void finish();
+
+    const char *Name;
+    std::string Detail;
+    bool Active;
+    uint64_t Begin;
+  };
+
+}}
+
+#endif
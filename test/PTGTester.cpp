@@ -165,6 +165,18 @@ bool check(PTGTester &PTG, ptr::PointsToSets &S)
     return true;
 }
 
+bool check(bool cond, const char *msg)
+{
+    ++total;
+
+    if (!cond) {
+        ++failed;
+        errs() << "FAILED: " << msg << "\n";
+    }
+
+    return cond;
+}
+
 std::pair<int, int> getResults(void)
 {
     return std::pair<int, int>(failed, total);
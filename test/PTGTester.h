@@ -193,6 +193,8 @@ void addPointsTo(llvm::Module *M, PointsToSets& PTSets,
 
 bool check(PointsToSets &A, PointsToSets &B);
 bool check(PTGTester &PTG, PointsToSets &S);
+// count a test of anything else, msg is printed when cond is false
+bool check(bool cond, const char *msg);
 
 void notTested(const char *msg);
 
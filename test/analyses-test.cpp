@@ -0,0 +1,392 @@
+#include <llvm/Function.h>
+#include <llvm/Instructions.h>
+#include <llvm/LLVMContext.h>
+#include <llvm/Module.h>
+#include <llvm/Pass.h>
+#include <llvm/PassManager.h>
+#include <llvm/ADT/OwningPtr.h>
+#include <llvm/Assembly/Parser.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/SourceMgr.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/system_error.h>
+#include <cstdlib>
+#include <memory>
+#include <set>
+#include <string>
+
+#include "../src/Cache/AnalysisCache.h"
+#include "../src/Cache/AnalysisPasses.h"
+#include "../src/Support/Trace.h"
+
+using namespace llvm;
+
+// Checks the callgraph, the mod-sets and the analysis cache on small
+// modules.
+
+typedef callgraph::Callgraph Callgraph;
+
+static int failed = 0;
+static int total = 0;
+
+static void check(bool cond, const char *test, const char *msg)
+{
+    ++total;
+
+    if (!cond) {
+        ++failed;
+        errs() << "FAILED: " << test << ": " << msg << "\n";
+    }
+}
+
+static Module *parse(const char *IR, LLVMContext &C)
+{
+    SMDiagnostic SMD;
+    Module *M = ParseAssemblyString(IR, 0, SMD, C);
+
+    if (!M) {
+        SMD.print("analyses-test", errs());
+        abort();
+    }
+
+    return M;
+}
+
+// sorted names of the functions in R separated by spaces
+static std::string names(Callgraph::closure_range R)
+{
+    std::set<std::string> S;
+    std::string Out;
+
+    for (Callgraph::closure_iterator I = R.first; I != R.second; ++I)
+        S.insert(I->second->getName().str());
+
+    for (std::set<std::string>::const_iterator I = S.begin(), E = S.end();
+         I != E; ++I)
+        Out += (Out.empty() ? "" : " ") + *I;
+
+    return Out;
+}
+
+// a and b are recursive, e is called by nobody
+static const char *callsIR =
+    "define void @d() {\n"
+    "  ret void\n"
+    "}\n"
+    "define void @c() {\n"
+    "  call void @d()\n"
+    "  ret void\n"
+    "}\n"
+    "define void @b(i32 %n) {\n"
+    "  call void @a(i32 %n)\n"
+    "  call void @c()\n"
+    "  ret void\n"
+    "}\n"
+    "define void @a(i32 %n) {\n"
+    "  call void @b(i32 %n)\n"
+    "  ret void\n"
+    "}\n"
+    "define void @e() {\n"
+    "  call void @c()\n"
+    "  ret void\n"
+    "}\n"
+    "define i32 @main() {\n"
+    "  call void @a(i32 1)\n"
+    "  ret i32 0\n"
+    "}\n";
+
+static void closure(void)
+{
+    LLVMContext C;
+    OwningPtr<Module> M(parse(callsIR, C));
+    cache::ProgramAnalyses A;
+
+    cache::computeAnalyses(*M, A, cache::ProgramAnalyses::CALLGRAPH);
+
+    const Callgraph &CG = *A.CG;
+    const Function *a = M->getFunction("a"), *c = M->getFunction("c");
+
+    check(names(CG.calls(M->getFunction("main"))) == "a b c d", __func__,
+          "main calls everything but e");
+    check(names(CG.calls(a)) == "a b c d", __func__,
+          "a calls itself through b");
+    check(names(CG.calls(c)) == "d", __func__, "c calls only d");
+    check(names(CG.calls(M->getFunction("d"))) == "", __func__,
+          "d calls nothing");
+    check(names(CG.callees(c)) == "a b e main", __func__,
+          "c is called from a, b, e and main");
+    check(names(CG.callees(a)) == "a b main", __func__,
+          "a is called from a, b and main");
+
+    check(CG.getSCCIndex(a) == CG.getSCCIndex(M->getFunction("b")),
+          __func__, "a and b are one SCC");
+    check(CG.isRecursive(CG.getSCCIndex(a)), __func__,
+          "the SCC of a is recursive");
+    check(!CG.isRecursive(CG.getSCCIndex(c)), __func__,
+          "c is not recursive");
+    check(CG.getSCCIndex(c) < CG.getSCCIndex(a), __func__,
+          "callees come first");
+}
+
+// does the mod-set of F have some part of the value named V?
+static bool modifies(const cache::ProgramAnalyses &A, const Function *F,
+                     const Value *V)
+{
+    const mods::Modifies::ModSet &S = mods::getModSet(F, A.MOD);
+
+    for (mods::Modifies::ModSet::const_iterator I = S.begin(), E = S.end();
+         I != E; ++I)
+        if (I->first == V)
+            return true;
+
+    return false;
+}
+
+// h writes to a local of mid, which is not visible in top, main stores a
+// null pointer
+static const char *modsIR =
+    "@g = global i32 0\n"
+    "define void @h(i32* %p) {\n"
+    "  store i32 1, i32* %p\n"
+    "  store i32 2, i32* @g\n"
+    "  ret void\n"
+    "}\n"
+    "define void @mid() {\n"
+    "  %l = alloca i32\n"
+    "  call void @h(i32* %l)\n"
+    "  ret void\n"
+    "}\n"
+    "define void @top() {\n"
+    "  call void @mid()\n"
+    "  ret void\n"
+    "}\n"
+    "define i32 @main() {\n"
+    "  %p = alloca i32*\n"
+    "  store i32* null, i32** %p\n"
+    "  call void @top()\n"
+    "  ret i32 0\n"
+    "}\n";
+
+static void modSets(void)
+{
+    LLVMContext C;
+    OwningPtr<Module> M(parse(modsIR, C));
+    cache::ProgramAnalyses A;
+
+    cache::computeAnalyses(*M, A);
+
+    const Function *h = M->getFunction("h"), *mid = M->getFunction("mid"),
+          *top = M->getFunction("top");
+    const Value *l = &mid->getEntryBlock().front();
+    const Value *g = M->getGlobalVariable("g");
+
+    check(modifies(A, h, l), __func__, "h modifies the local of mid");
+    check(!modifies(A, mid, l), __func__, "mid drops its own local");
+    check(!modifies(A, top, l), __func__,
+          "the local of mid does not leak into top");
+    check(modifies(A, h, g) && modifies(A, mid, g) && modifies(A, top, g),
+          __func__, "the global is modified all the way up");
+    check(&mods::getModSet(mid, A.MOD) == &mods::getModSet(top, A.MOD),
+          __func__, "mid and top share their mod-set");
+}
+
+// the results the analysis passes gave to one pass
+struct Results {
+    std::shared_ptr<const ptr::PointsToSets> PS;
+    std::shared_ptr<const callgraph::Callgraph> CG;
+    std::shared_ptr<const mods::Modifies> MOD;
+};
+
+namespace {
+    class ResultsUser : public ModulePass {
+    public:
+        static char ID;
+
+        ResultsUser(Results *R = 0) : ModulePass(ID), R(R) {}
+
+        virtual bool runOnModule(Module &M) {
+            R->PS = getAnalysis<cache::PointsToAnalysis>().getResult();
+            R->CG = getAnalysis<cache::CallgraphAnalysis>().getResult();
+            R->MOD = getAnalysis<cache::ModifiesAnalysis>().getResult();
+            return false;
+        }
+
+        void getAnalysisUsage(AnalysisUsage &AU) const {
+            AU.addRequired<cache::PointsToAnalysis>();
+            AU.addRequired<cache::CallgraphAnalysis>();
+            AU.addRequired<cache::ModifiesAnalysis>();
+            AU.setPreservesAll();
+        }
+
+    private:
+        Results *R;
+    };
+
+    // changes nothing, but does not say so
+    class NopTransform : public ModulePass {
+    public:
+        static char ID;
+
+        NopTransform() : ModulePass(ID) {}
+
+        virtual bool runOnModule(Module &M) { return false; }
+    };
+
+    // makes the first alloca of main point to @g too
+    class StoreTransform : public ModulePass {
+    public:
+        static char ID;
+
+        StoreTransform() : ModulePass(ID) {}
+
+        virtual bool runOnModule(Module &M) {
+            BasicBlock &Entry = M.getFunction("main")->getEntryBlock();
+            new StoreInst(M.getGlobalVariable("g"), &Entry.front(),
+                          Entry.getTerminator());
+            return true;
+        }
+    };
+}
+
+static RegisterPass<ResultsUser> RU("test-results-user",
+                                    "Remembers the analysis results");
+char ResultsUser::ID;
+static RegisterPass<NopTransform> NT("test-nop-transform",
+                                     "Changes nothing");
+char NopTransform::ID;
+static RegisterPass<StoreTransform> ST("test-store-transform",
+                                       "Adds a pointer store to main");
+char StoreTransform::ID;
+
+// results are reused after a pass which left the module as it was and
+// computed again after one which changed the pointers
+static void reuse(void)
+{
+    LLVMContext C;
+    OwningPtr<Module> M(parse(modsIR, C));
+    Results Before, Same, Changed;
+
+    PassManager PM;
+    PM.add(new ResultsUser(&Before));
+    PM.add(new NopTransform());
+    PM.add(new ResultsUser(&Same));
+    PM.add(new StoreTransform());
+    PM.add(new ResultsUser(&Changed));
+    PM.run(*M);
+    cache::forgetResults();
+
+    check(Same.PS == Before.PS, __func__,
+          "points-to sets of the same module are reused");
+    check(Same.CG == Before.CG, __func__,
+          "the callgraph of the same module is reused");
+    check(Same.MOD == Before.MOD, __func__,
+          "mod-sets of the same module are reused");
+    check(Changed.PS != Same.PS, __func__,
+          "a new pointer store computes points-to sets again");
+    check(Changed.CG != Same.CG, __func__,
+          "new points-to sets compute the callgraph again");
+    check(Changed.MOD != Same.MOD, __func__,
+          "new points-to sets compute mod-sets again");
+}
+
+typedef std::set<std::pair<const Function *, const Function *> > Calls;
+
+static Calls getCalls(const Callgraph &CG)
+{
+    return Calls(CG.begin(), CG.end());
+}
+
+static bool sameModSets(const mods::Modifies &A, const mods::Modifies &B)
+{
+    if (A.getContainer().size() != B.getContainer().size())
+        return false;
+
+    for (mods::Modifies::const_iterator I = A.begin(), E = A.end(); I != E;
+         ++I)
+        if (*I->second != mods::getModSet(I->first, B))
+            return false;
+
+    return true;
+}
+
+static void removeDir(const char *Dir)
+{
+    error_code EC;
+    bool Existed;
+
+    for (sys::fs::directory_iterator I(Dir, EC), E; I != E && !EC;
+         I.increment(EC))
+        sys::fs::remove(I->path(), Existed);
+    sys::fs::remove(Dir, Existed);
+}
+
+// what is stored is loaded back the same, a bogus file is only a miss
+static void cacheRoundTrip(void)
+{
+    static const char *Dir = "analyses-test.cache";
+    const char *Args[] = {
+        "analyses-test", "-analysis-cache-dir=analyses-test.cache"
+    };
+
+    removeDir(Dir);
+    cl::ParseCommandLineOptions(2, Args);
+
+    LLVMContext C;
+    OwningPtr<Module> M(parse(modsIR, C));
+    cache::ProgramAnalyses Computed, Loaded, Recomputed;
+
+    trace::takeTotals();
+    cache::computeAnalyses(*M, Computed);
+    check(trace::takeTotals().count("pta"), __func__,
+          "the first run computes");
+
+    cache::computeAnalyses(*M, Loaded);
+    check(!trace::takeTotals().count("pta"), __func__,
+          "the second run loads");
+
+    check(Computed.PS.getContainer() == Loaded.PS.getContainer(), __func__,
+          "points-to sets are loaded back");
+    const Value *P = &M->getFunction("main")->getEntryBlock().front();
+    check(ptr::getPointsToSet(P, Loaded.PS).size() == 1, __func__,
+          "the null pointee is loaded back");
+    check(getCalls(*Computed.CG) == getCalls(*Loaded.CG), __func__,
+          "calls are loaded back");
+    check(sameModSets(Computed.MOD, Loaded.MOD), __func__,
+          "mod-sets are loaded back");
+
+    error_code EC;
+    for (sys::fs::directory_iterator I(Dir, EC), E; I != E && !EC;
+         I.increment(EC)) {
+        std::string Err;
+        raw_fd_ostream OS(I->path().c_str(), Err, raw_fd_ostream::F_Binary);
+        OS << "bogus";
+    }
+
+    cache::computeAnalyses(*M, Recomputed);
+    check(trace::takeTotals().count("pta"), __func__,
+          "a bogus file is recomputed");
+    check(Computed.PS.getContainer() == Recomputed.PS.getContainer(),
+          __func__, "points-to sets are recomputed");
+
+    removeDir(Dir);
+}
+
+int main(int argc, char **argv)
+{
+    // before the first trace scope, the cache is told by the totals
+    trace::collectTotals();
+
+    closure();
+    modSets();
+    // before the cache directory is set
+    reuse();
+    cacheRoundTrip();
+
+    if (failed)
+        errs() << failed << " tests from " << total << " failed!\n";
+    else
+        errs() << "All tests passed!\n";
+
+    return failed != 0;
+}
@@ -0,0 +1,72 @@
+; Handlers called through a table of function pointers.
+
+@state = global i32 0, align 4
+@counter = global i32 0, align 4
+@table = global [3 x void (i32*)*] [void (i32*)* @inc, void (i32*)* @dec, void (i32*)* @reset], align 16
+@.str = private unnamed_addr constant [11 x i8] c"state >= 0\00", align 1
+@.file = private unnamed_addr constant [11 x i8] c"indirect.c\00", align 1
+@__PRETTY_FUNCTION__.main = private unnamed_addr constant [11 x i8] c"int main()\00", align 1
+
+define void @inc(i32* %p) nounwind {
+entry:
+  %v = load i32* %p, align 4
+  %a = add nsw i32 %v, 1
+  store i32 %a, i32* %p, align 4
+  ret void
+}
+
+define void @dec(i32* %p) nounwind {
+entry:
+  %v = load i32* %p, align 4
+  %a = sub nsw i32 %v, 1
+  store i32 %a, i32* %p, align 4
+  ret void
+}
+
+define void @reset(i32* %p) nounwind {
+entry:
+  store i32 0, i32* %p, align 4
+  %c = load i32* @counter, align 4
+  %a = add nsw i32 %c, 1
+  store i32 %a, i32* @counter, align 4
+  ret void
+}
+
+define void @dispatch(i32 %op, i32* %p) nounwind {
+entry:
+  %idx = sext i32 %op to i64
+  %slot = getelementptr inbounds [3 x void (i32*)*]* @table, i64 0, i64 %idx
+  %fn = load void (i32*)** %slot, align 8
+  call void %fn(i32* %p) nounwind
+  ret void
+}
+
+define i32 @main() nounwind {
+entry:
+  %local = alloca i32, align 4
+  store i32 0, i32* %local, align 4
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %inc, %loop ]
+  %op = srem i32 %i, 3
+  call void @dispatch(i32 %op, i32* @state)
+  call void @dispatch(i32 %op, i32* %local)
+  %inc = add nsw i32 %i, 1
+  %cmp = icmp slt i32 %inc, 30
+  br i1 %cmp, label %loop, label %check
+
+check:
+  %s = load i32* @state, align 4
+  %ok = icmp sge i32 %s, 0
+  br i1 %ok, label %end, label %fail
+
+fail:
+  call void @__assert_fail(i8* getelementptr inbounds ([11 x i8]* @.str, i32 0, i32 0), i8* getelementptr inbounds ([11 x i8]* @.file, i32 0, i32 0), i32 40, i8* getelementptr inbounds ([11 x i8]* @__PRETTY_FUNCTION__.main, i32 0, i32 0)) noreturn nounwind
+  unreachable
+
+end:
+  ret i32 0
+}
+
+declare void @__assert_fail(i8*, i8*, i32, i8*) noreturn nounwind
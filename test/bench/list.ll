@@ -0,0 +1,93 @@
+; A linked list built and summed in loops, the assert depends on the sum.
+
+%struct.node = type { i32, %struct.node* }
+
+@.str = private unnamed_addr constant [8 x i8] c"sum > 0\00", align 1
+@.file = private unnamed_addr constant [7 x i8] c"list.c\00", align 1
+@__PRETTY_FUNCTION__.main = private unnamed_addr constant [11 x i8] c"int main()\00", align 1
+
+define %struct.node* @push(%struct.node* %head, i32 %v) nounwind {
+entry:
+  %call = call noalias i8* @malloc(i64 16) nounwind
+  %n = bitcast i8* %call to %struct.node*
+  %val = getelementptr inbounds %struct.node* %n, i32 0, i32 0
+  store i32 %v, i32* %val, align 4
+  %next = getelementptr inbounds %struct.node* %n, i32 0, i32 1
+  store %struct.node* %head, %struct.node** %next, align 8
+  ret %struct.node* %n
+}
+
+define i32 @sum(%struct.node* %head) nounwind {
+entry:
+  br label %loop
+
+loop:
+  %p = phi %struct.node* [ %head, %entry ], [ %nx, %body ]
+  %acc = phi i32 [ 0, %entry ], [ %add, %body ]
+  %cmp = icmp eq %struct.node* %p, null
+  br i1 %cmp, label %done, label %body
+
+body:
+  %vp = getelementptr inbounds %struct.node* %p, i32 0, i32 0
+  %v = load i32* %vp, align 4
+  %add = add nsw i32 %acc, %v
+  %np = getelementptr inbounds %struct.node* %p, i32 0, i32 1
+  %nx = load %struct.node** %np, align 8
+  br label %loop
+
+done:
+  ret i32 %acc
+}
+
+define void @release(%struct.node* %head) nounwind {
+entry:
+  %cmp = icmp eq %struct.node* %head, null
+  br i1 %cmp, label %done, label %body
+
+body:
+  %np = getelementptr inbounds %struct.node* %head, i32 0, i32 1
+  %nx = load %struct.node** %np, align 8
+  call void @release(%struct.node* %nx)
+  %m = bitcast %struct.node* %head to i8*
+  call void @free(i8* %m) nounwind
+  br label %done
+
+done:
+  ret void
+}
+
+define i32 @main() nounwind {
+entry:
+  %head = alloca %struct.node*, align 8
+  store %struct.node* null, %struct.node** %head, align 8
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %inc, %loop ]
+  %h = load %struct.node** %head, align 8
+  %n = call %struct.node* @push(%struct.node* %h, i32 %i)
+  store %struct.node* %n, %struct.node** %head, align 8
+  %inc = add nsw i32 %i, 1
+  %cmp = icmp slt i32 %inc, 100
+  br i1 %cmp, label %loop, label %check
+
+check:
+  %h2 = load %struct.node** %head, align 8
+  %s = call i32 @sum(%struct.node* %h2)
+  %ok = icmp sgt i32 %s, 0
+  br i1 %ok, label %end, label %fail
+
+fail:
+  call void @__assert_fail(i8* getelementptr inbounds ([8 x i8]* @.str, i32 0, i32 0), i8* getelementptr inbounds ([7 x i8]* @.file, i32 0, i32 0), i32 30, i8* getelementptr inbounds ([11 x i8]* @__PRETTY_FUNCTION__.main, i32 0, i32 0)) noreturn nounwind
+  unreachable
+
+end:
+  call void @release(%struct.node* %h2)
+  ret i32 0
+}
+
+declare noalias i8* @malloc(i64) nounwind
+
+declare void @free(i8*) nounwind
+
+declare void @__assert_fail(i8*, i8*, i32, i8*) noreturn nounwind
@@ -0,0 +1,53 @@
+; Structures with pointer fields copied by memcpy, the criterion is a store
+; to an __ai_state_ variable.
+
+%struct.pair = type { i32*, i32* }
+
+@__ai_state_1 = common global i32 0, align 4
+@x = global i32 1, align 4
+@y = global i32 2, align 4
+
+define void @fill(%struct.pair* %p) nounwind {
+entry:
+  %f = getelementptr inbounds %struct.pair* %p, i32 0, i32 0
+  store i32* @x, i32** %f, align 8
+  %s = getelementptr inbounds %struct.pair* %p, i32 0, i32 1
+  store i32* @y, i32** %s, align 8
+  ret void
+}
+
+define void @swap(%struct.pair* %p) nounwind {
+entry:
+  %tmp = alloca %struct.pair, align 8
+  %d = bitcast %struct.pair* %tmp to i8*
+  %s = bitcast %struct.pair* %p to i8*
+  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %d, i8* %s, i64 16, i32 8, i1 false)
+  %f = getelementptr inbounds %struct.pair* %p, i32 0, i32 0
+  %s1 = getelementptr inbounds %struct.pair* %tmp, i32 0, i32 1
+  %b = load i32** %s1, align 8
+  store i32* %b, i32** %f, align 8
+  %sp = getelementptr inbounds %struct.pair* %p, i32 0, i32 1
+  %f1 = getelementptr inbounds %struct.pair* %tmp, i32 0, i32 0
+  %a = load i32** %f1, align 8
+  store i32* %a, i32** %sp, align 8
+  ret void
+}
+
+define i32 @main() nounwind {
+entry:
+  %p = alloca %struct.pair, align 8
+  call void @fill(%struct.pair* %p)
+  call void @swap(%struct.pair* %p)
+  %f = getelementptr inbounds %struct.pair* %p, i32 0, i32 0
+  %ptr = load i32** %f, align 8
+  %v = load i32* %ptr, align 4
+  store i32 %v, i32* @__ai_state_1, align 4
+  %s = getelementptr inbounds %struct.pair* %p, i32 0, i32 1
+  %ptr2 = load i32** %s, align 8
+  store i32 7, i32* %ptr2, align 4
+  ret i32 0
+}
+
+declare void @llvm.memcpy.p0i8.p0i8.i64(i8* nocapture, i8* nocapture, i64, i32, i1) nounwind
+
+declare void @__assert_fail(i8*, i8*, i32, i8*) noreturn nounwind
@@ -0,0 +1,395 @@
+#include <llvm/Constants.h>
+#include <llvm/DerivedTypes.h>
+#include <llvm/Function.h>
+#include <llvm/GlobalVariable.h>
+#include <llvm/IRBuilder.h>
+#include <llvm/LLVMContext.h>
+#include <llvm/Module.h>
+#include <llvm/Analysis/Verifier.h>
+#include <llvm/Support/raw_ostream.h>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+// Generates modules of a given size and shape to see how the analyses
+// scale. Every function takes an i32* and does, inside a nest of loops:
+// pointer assignments of all the kinds the points-to analysis knows, a
+// memcpy of a structure of pointers, direct calls and an indirect call
+// through a table of function pointers. Some functions end with an assert
+// the slicer takes as a criterion. The output is deterministic for a seed.
+// With -signatures, the functions get that many types (more int
+// parameters, and a returned i32* every other one), so that indirect calls
+// have to find the candidates of their own type.
+
+struct Params {
+    Params() : functions(100), pointers(10), fanout(4), copyBytes(64),
+        loopDepth(1), asserts(1), calls(2), signatures(1), seed(1) {}
+
+    unsigned functions;  // number of generated functions
+    unsigned pointers;   // pointer assignments per loop body
+    unsigned fanout;     // functions in each table of indirect call targets
+    unsigned copyBytes;  // bytes memcpy'd in every function, 0 for none
+    unsigned loopDepth;  // loops nested around the body
+    unsigned asserts;    // functions with an __assert_fail
+    unsigned calls;      // direct calls per loop body
+    unsigned signatures; // function types
+    unsigned seed;
+};
+
+class Generator {
+public:
+    Generator(LLVMContext &C, const Params &P) : C(C), P(P), Rand(P.seed),
+        M(new Module("generated", C)), B(C) {}
+
+    Module *generate();
+
+private:
+    unsigned pick(unsigned N) {
+        return std::uniform_int_distribution<unsigned>(0, N - 1)(Rand);
+    }
+
+    void declare();
+    void define(unsigned idx);
+    void emitLoops(Function *F, unsigned depth, Value *arg, Value *counter,
+                   unsigned idx);
+    void emitBody(Value *arg, Value *counter, unsigned idx);
+    void emitCall(Value *Fn, FunctionType *Ty, Value *arg, Value *counter);
+    void emitAssert(Function *F, unsigned idx);
+    void defineMain();
+
+    LLVMContext &C;
+    Params P;
+    std::mt19937 Rand;
+    Module *M;
+    IRBuilder<> B;
+
+    Type *I32, *I32Ptr;
+    std::vector<FunctionType *> FunTys;
+    StructType *RecTy;
+    Function *Malloc, *AssertFail;
+    std::vector<Function *> Funs;
+    std::vector<GlobalVariable *> Ints, Ptrs, Tables;
+    std::vector<FunctionType *> TableTys;
+    std::vector<bool> HasAssert;
+
+    /* locals of the function being defined */
+    AllocaInst *Slot, *RecA, *RecB;
+};
+
+void Generator::declare()
+{
+    I32 = Type::getInt32Ty(C);
+    I32Ptr = PointerType::getUnqual(I32);
+
+    /* signature s: i32* and s / 2 i32 params, odd ones return i32* */
+    for (unsigned s = 0; s < P.signatures; ++s) {
+        std::vector<Type *> Params(1 + s / 2, I32);
+        Params[0] = I32Ptr;
+        FunTys.push_back(FunctionType::get(s % 2 ? I32Ptr :
+                                           Type::getVoidTy(C), Params,
+                                           false));
+    }
+
+    /* copyBytes are rounded to whole pointers */
+    unsigned fields = P.copyBytes / 8 ? P.copyBytes / 8 : 1;
+    RecTy = StructType::create(C, std::vector<Type *>(fields, I32Ptr),
+                               "struct.rec");
+
+    Type *I8Ptr = Type::getInt8PtrTy(C);
+    Malloc = Function::Create(FunctionType::get(I8Ptr, Type::getInt64Ty(C),
+                                                false),
+                              GlobalValue::ExternalLinkage, "malloc", M);
+    Type *AssertArgs[] = { I8Ptr, I8Ptr, I32, I8Ptr };
+    AssertFail = Function::Create(FunctionType::get(Type::getVoidTy(C),
+                                                    AssertArgs, false),
+                                  GlobalValue::ExternalLinkage,
+                                  "__assert_fail", M);
+    AssertFail->setDoesNotReturn();
+
+    std::vector<std::vector<Function *> > BySig(P.signatures);
+    for (unsigned i = 0; i < P.functions; ++i) {
+        Funs.push_back(Function::Create(FunTys[i % P.signatures],
+                                        GlobalValue::ExternalLinkage,
+                                        "f" + Twine(i), M));
+        BySig[i % P.signatures].push_back(Funs.back());
+        Ints.push_back(new GlobalVariable(*M, I32, false,
+                                          GlobalValue::CommonLinkage,
+                                          ConstantInt::get(I32, 0),
+                                          "g" + Twine(i)));
+        Ptrs.push_back(new GlobalVariable(*M, I32Ptr, false,
+                                          GlobalValue::CommonLinkage,
+                                          ConstantPointerNull::get(
+                                              cast<PointerType>(I32Ptr)),
+                                          "p" + Twine(i)));
+    }
+
+    /*
+     * table t of a signature holds its functions t * fanout,
+     * t * fanout + 1, ...
+     */
+    for (unsigned s = 0; P.fanout && s < P.signatures; ++s) {
+        const std::vector<Function *> &Sig = BySig[s];
+        ArrayType *TableTy = ArrayType::get(PointerType::getUnqual(FunTys[s]),
+                                            P.fanout);
+        unsigned tables = (Sig.size() + P.fanout - 1) / P.fanout;
+
+        for (unsigned t = 0; t < tables; ++t) {
+            std::vector<Constant *> Elems;
+            for (unsigned k = 0; k < P.fanout; ++k)
+                Elems.push_back(Sig[(t * P.fanout + k) % Sig.size()]);
+            Tables.push_back(new GlobalVariable(*M, TableTy, true,
+                                                GlobalValue::InternalLinkage,
+                                                ConstantArray::get(TableTy,
+                                                                   Elems),
+                                                "table" +
+                                                Twine(Tables.size())));
+            TableTys.push_back(FunTys[s]);
+        }
+    }
+
+    /* spread the asserts over the functions */
+    HasAssert.resize(P.functions);
+    for (unsigned i = 0; i < P.asserts && i < P.functions; ++i)
+        HasAssert[i * P.functions / P.asserts] = true;
+}
+
+void Generator::emitBody(Value *arg, Value *counter, unsigned idx)
+{
+    for (unsigned i = 0; i < P.pointers; ++i) {
+        GlobalVariable *G = Ints[pick(Ints.size())];
+        GlobalVariable *GP = Ptrs[pick(Ptrs.size())];
+
+        switch (pick(6)) {
+        case 0: /* q = &g */
+            B.CreateStore(G, Slot);
+            break;
+        case 1: /* *q = i */
+            B.CreateStore(counter, B.CreateLoad(Slot));
+            break;
+        case 2: /* p = q */
+            B.CreateStore(B.CreateLoad(Slot), GP);
+            break;
+        case 3: /* q = p */
+            B.CreateStore(B.CreateLoad(GP), Slot);
+            break;
+        case 4: /* p = arg */
+            B.CreateStore(arg, GP);
+            break;
+        case 5: /* q = malloc() */
+            B.CreateStore(B.CreateBitCast(B.CreateCall(Malloc,
+                                                       B.getInt64(4)),
+                                          I32Ptr), Slot);
+            break;
+        }
+    }
+
+    if (P.copyBytes) {
+        unsigned last = RecTy->getNumElements() - 1;
+        B.CreateStore(Ints[idx], B.CreateStructGEP(RecA, 0));
+        B.CreateStore(arg, B.CreateStructGEP(RecA, last));
+        B.CreateMemCpy(RecB, RecA, (last + 1) * 8, 8);
+        B.CreateStore(B.CreateLoad(B.CreateStructGEP(RecB, pick(last + 1))),
+                      Slot);
+    }
+
+    for (unsigned i = 0; i < P.calls; ++i) {
+        Function *F = Funs[pick(Funs.size())];
+        emitCall(F, F->getFunctionType(), B.CreateLoad(Slot), counter);
+    }
+
+    if (!Tables.empty()) {
+        Value *Index = B.CreateSExt(B.CreateSRem(counter,
+                                                 B.getInt32(P.fanout)),
+                                    B.getInt64Ty());
+        Value *Idx[] = { B.getInt64(0), Index };
+        unsigned t = idx % Tables.size();
+        Value *Fn = B.CreateLoad(B.CreateInBoundsGEP(Tables[t], Idx));
+        emitCall(Fn, TableTys[t], arg, counter);
+    }
+}
+
+/* the int parameters get the counter, a returned pointer goes to q */
+void Generator::emitCall(Value *Fn, FunctionType *Ty, Value *arg,
+                         Value *counter)
+{
+    std::vector<Value *> Args(Ty->getNumParams(), counter);
+    Args[0] = arg;
+
+    CallInst *CI = B.CreateCall(Fn, Args);
+    if (!Ty->getReturnType()->isVoidTy())
+        B.CreateStore(CI, Slot);
+}
+
+void Generator::emitLoops(Function *F, unsigned depth, Value *arg,
+                          Value *counter, unsigned idx)
+{
+    if (!depth) {
+        emitBody(arg, counter, idx);
+        return;
+    }
+
+    BasicBlock *Pre = B.GetInsertBlock();
+    BasicBlock *Header = BasicBlock::Create(C, "loop", F);
+    BasicBlock *Body = BasicBlock::Create(C, "body", F);
+    BasicBlock *Exit = BasicBlock::Create(C, "exit", F);
+
+    B.CreateBr(Header);
+    B.SetInsertPoint(Header);
+    PHINode *I = B.CreatePHI(I32, 2, "i");
+    I->addIncoming(B.getInt32(0), Pre);
+    B.CreateCondBr(B.CreateICmpSLT(I, B.getInt32(4)), Body, Exit);
+
+    B.SetInsertPoint(Body);
+    emitLoops(F, depth - 1, arg, I, idx);
+    I->addIncoming(B.CreateAdd(I, B.getInt32(1)), B.GetInsertBlock());
+    B.CreateBr(Header);
+
+    B.SetInsertPoint(Exit);
+}
+
+void Generator::emitAssert(Function *F, unsigned idx)
+{
+    BasicBlock *Fail = BasicBlock::Create(C, "fail", F);
+    BasicBlock *Ok = BasicBlock::Create(C, "ok", F);
+
+    Value *V = B.CreateLoad(Ints[(idx + 1) % Ints.size()]);
+    B.CreateCondBr(B.CreateICmpSGE(V, B.getInt32(0)), Ok, Fail);
+
+    B.SetInsertPoint(Fail);
+    Value *Args[] = {
+        B.CreateGlobalStringPtr("g >= 0"),
+        B.CreateGlobalStringPtr("generated.c"),
+        B.getInt32(idx),
+        B.CreateGlobalStringPtr(F->getName())
+    };
+    B.CreateCall(AssertFail, Args);
+    B.CreateUnreachable();
+
+    B.SetInsertPoint(Ok);
+}
+
+void Generator::define(unsigned idx)
+{
+    Function *F = Funs[idx];
+    Value *arg = F->arg_begin();
+
+    B.SetInsertPoint(BasicBlock::Create(C, "entry", F));
+    Slot = B.CreateAlloca(I32Ptr, 0, "q");
+    RecA = B.CreateAlloca(RecTy, 0, "a");
+    RecB = B.CreateAlloca(RecTy, 0, "b");
+    B.CreateStore(arg, Slot);
+
+    emitLoops(F, P.loopDepth, arg, B.getInt32(idx), idx);
+
+    if (HasAssert[idx])
+        emitAssert(F, idx);
+    if (F->getReturnType()->isVoidTy())
+        B.CreateRetVoid();
+    else
+        B.CreateRet(arg);
+}
+
+/* main calls the first function and all those with an assert */
+void Generator::defineMain()
+{
+    Function *Main = Function::Create(FunctionType::get(I32, false),
+                                      GlobalValue::ExternalLinkage, "main",
+                                      M);
+    B.SetInsertPoint(BasicBlock::Create(C, "entry", Main));
+
+    for (unsigned i = 0; i < Funs.size(); ++i)
+        if (!i || HasAssert[i]) {
+            std::vector<Value *> Args(Funs[i]->arg_size(), B.getInt32(0));
+            Args[0] = Ints[i];
+            B.CreateCall(Funs[i], Args);
+        }
+    B.CreateRet(B.getInt32(0));
+}
+
+Module *Generator::generate()
+{
+    M->setTargetTriple("x86_64-unknown-linux-gnu");
+    M->setDataLayout("e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-"
+                     "i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-"
+                     "a0:0:64-s0:64:64-f80:128:128-n8:16:32:64-S128");
+
+    declare();
+    for (unsigned i = 0; i < Funs.size(); ++i)
+        define(i);
+    defineMain();
+
+    return M;
+}
+
+int main(int argc, char **argv)
+{
+    const char *output = "-";
+    Params P;
+
+    for (int i = 1; i < argc; ++i) {
+        unsigned *opt = NULL;
+
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+            continue;
+        }
+
+        if (strcmp(argv[i], "-functions") == 0)
+            opt = &P.functions;
+        else if (strcmp(argv[i], "-pointers") == 0)
+            opt = &P.pointers;
+        else if (strcmp(argv[i], "-fanout") == 0)
+            opt = &P.fanout;
+        else if (strcmp(argv[i], "-memcpy") == 0)
+            opt = &P.copyBytes;
+        else if (strcmp(argv[i], "-loop-depth") == 0)
+            opt = &P.loopDepth;
+        else if (strcmp(argv[i], "-asserts") == 0)
+            opt = &P.asserts;
+        else if (strcmp(argv[i], "-calls") == 0)
+            opt = &P.calls;
+        else if (strcmp(argv[i], "-signatures") == 0)
+            opt = &P.signatures;
+        else if (strcmp(argv[i], "-seed") == 0)
+            opt = &P.seed;
+
+        if (!opt || i + 1 == argc) {
+            errs() << "Usage: program [-functions N] [-pointers N] "
+                "[-fanout N] [-memcpy bytes] [-loop-depth N] [-asserts N] "
+                "[-calls N] [-signatures N] [-seed N] [-o output.ll]\n";
+            return 1;
+        }
+        *opt = strtoul(argv[++i], NULL, 0);
+    }
+
+    if (!P.functions)
+        P.functions = 1;
+    if (!P.signatures)
+        P.signatures = 1;
+    if (P.signatures > P.functions)
+        P.signatures = P.functions;
+
+    LLVMContext context;
+    Module *M = Generator(context, P).generate();
+
+    if (verifyModule(*M, PrintMessageAction)) {
+        delete M;
+        return 1;
+    }
+
+    std::string err;
+    raw_fd_ostream OS(output, err);
+    if (!err.empty()) {
+        errs() << "Cannot write " << output << ": " << err << "\n";
+        delete M;
+        return 1;
+    }
+    M->print(OS, NULL);
+
+    delete M;
+    return 0;
+}
@@ -1,11 +1,14 @@
 #include <llvm/LLVMContext.h>
 #include <llvm/Function.h>
+#include <llvm/GlobalVariable.h>
 #include <llvm/Module.h>
 #include <llvm/Support/IRReader.h>
 #include <llvm/Support/raw_ostream.h>
 #include <ctime>
+#include <sys/resource.h>
 
 #include "../src/PointsTo/PointsTo.h"
+#include "PTGTester.h"
 
 using namespace llvm;
 using ptr::PointsToSets;
@@ -35,7 +38,47 @@ static long int countPairs(const PointsToSets& PS)
     return pairs;
 }
 
-static long long unsigned pointsToPerf(Module &M, int N, unsigned K)
+static long peakRSS(void)
+{
+    struct rusage ru;
+
+    if (getrusage(RUSAGE_SELF, &ru))
+        return -1;
+
+    // in kilobytes on linux
+    return ru.ru_maxrss;
+}
+
+// look up every pointer of the module and walk its points-to set,
+// the way InsInfo and computeModifies do
+static long unsigned lookupPerf(Module &M, const PointsToSets &PS, int N)
+{
+    struct timespec s, e;
+    long unsigned found = 0;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &s);
+    for (int I = 0; I < N; ++I)
+        for (Module::const_iterator F = M.begin(); F != M.end(); ++F)
+            for (const_inst_iterator II = inst_begin(*F), EE = inst_end(*F);
+                 II != EE; ++II) {
+                PointsToSets::const_iterator it = PS.find(
+                            PointsToSets::Pointer(&*II, -1));
+                if (it == PS.end())
+                    continue;
+
+                for (PTSet::const_iterator PI = it->second.begin(),
+                     PE = it->second.end(); PI != PE; ++PI)
+                    ++found;
+            }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &e);
+
+    errs() << "Lookups found: " << found << "\n";
+
+    return 1000000000 * (e.tv_sec - s.tv_sec) + (e.tv_nsec - s.tv_nsec);
+}
+
+static long long unsigned pointsToPerf(Module &M, int N, unsigned K,
+                                       unsigned T)
 {
     ptr::ProgramStructure P(M);
     long long unsigned int sum = 0;
@@ -48,7 +91,7 @@ static long long unsigned pointsToPerf(Module &M, int N, unsigned K)
 
         // take measurement
 	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &s);
-        computePointsToSets(P, PS, K);
+        computePointsToSets(P, PS, K, T);
 	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &e);
 
 	long unsigned sn = 1000000000 * s.tv_sec + s.tv_nsec;
@@ -66,15 +109,118 @@ static long long unsigned pointsToPerf(Module &M, int N, unsigned K)
             cur += diff;
         }
 
-        if (I == N - 1)
+        if (I == N - 1) {
             errs() << "Pairs num: " << countPairs(PS) << "\n";
+            errs() << "Pointees interned: " << ptr::PointeeIndex::size() <<
+                "\n";
+            errs() << "Distinct sets: " <<
+                ptr::SharedPointeeSet::getNumInterned() << "\n";
+            errs() << "Lookup MSec: " <<
+                (double) lookupPerf(M, PS, N) / N / 1000000 << "\n";
+        }
     }
 
     // add last accumulation
     add(sum, cur, N);
+
+    {
+        ptr::PointsToGraph PTG(&P, new ptr::AllInOneCategory());
+        errs() << "Rules: " << P.getContainer().size() << "\n";
+        errs() << "Rule applications: " << PTG.getRuleApplications() << "\n";
+    }
+
     return sum;
 }
 
+// time of building the rules alone, mostly matching indirect calls and
+// returns with their candidate functions
+static void rulesPerf(Module &M, int N)
+{
+    struct timespec s, e;
+    size_t rules = 0;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &s);
+    for (int I = 0; I < N; ++I) {
+        ptr::ProgramStructure P(M);
+        rules = P.getContainer().size();
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &e);
+
+    errs() << "Rules: " << rules << "\n";
+    errs() << "Rule generation MSec: " <<
+        ((e.tv_sec - s.tv_sec) * 1000.0 +
+         (e.tv_nsec - s.tv_nsec) / 1000000.0) / N << "\n";
+}
+
+// wall time of the category runs with 1, 2, 4, ... MaxT threads
+static void scalingPerf(Module &M, int N, unsigned K, unsigned MaxT)
+{
+    ptr::ProgramStructure P(M);
+    double base = 0;
+
+    for (unsigned T = 1; ; T *= 2) {
+        if (T > MaxT)
+            T = MaxT;
+
+        struct timespec s, e;
+
+        clock_gettime(CLOCK_MONOTONIC, &s);
+        for (int I = 0; I < N; ++I) {
+            PointsToSets PS;
+            computePointsToSets(P, PS, K, T);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &e);
+
+        double msec = ((e.tv_sec - s.tv_sec) * 1000.0 +
+                       (e.tv_nsec - s.tv_nsec) / 1000000.0) / N;
+        if (T == 1)
+            base = msec;
+
+        errs() << "Threads: " << T << " Wall MSec: " << msec <<
+            " Speedup: " << base / msec << "\n";
+
+        if (T == MaxT)
+            break;
+    }
+}
+
+// Merge-heavy graph: a hub points to N locations (one big node), then
+// each of N fresh pointers gets its own pointee node and is made to point
+// into the big node too, which merges the two nodes every time.
+static void mergePerf(LLVMContext &context, unsigned N)
+{
+    Module M("merge-perf", context);
+    Type *Ty = Type::getInt32Ty(context);
+    std::vector<const Value *> Vars;
+
+    for (unsigned I = 0; I < 3 * N + 1; ++I)
+        Vars.push_back(new GlobalVariable(M, Ty, false,
+                                          GlobalValue::CommonLinkage,
+                                          NULL, "v"));
+
+    ptr::ProgramStructure P(M);
+    ptr::PointsToGraph PTG(&P, new ptr::AllInOneCategory());
+    ptr::PTGTester T(&PTG);
+    struct timespec s, e;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &s);
+    for (unsigned I = 0; I < N; ++I)
+        T.insert(PointsToSets::Pointer(Vars[0], -1),
+                 PointsToSets::Pointee(Vars[1 + I], 0));
+
+    for (unsigned I = 0; I < N; ++I) {
+        PointsToSets::Pointer R(Vars[1 + N + 2 * I], -1);
+
+        T.insert(R, PointsToSets::Pointee(Vars[2 + N + 2 * I], 0));
+        T.insert(R, PointsToSets::Pointee(Vars[1], 0));
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &e);
+
+    errs() << "Merges: " << PTG.getMerges() << "\n";
+    errs() << "Merge MSec: " << ((e.tv_sec - s.tv_sec) * 1000.0 +
+                                 (e.tv_nsec - s.tv_nsec) / 1000000.0) << "\n";
+}
+
 int main(int argc, char **argv)
 {
     LLVMContext context;
@@ -82,28 +228,58 @@ int main(int argc, char **argv)
     Module *M;
     long long int Measurement;
     int N = 0, K = 1;
+    unsigned T = 1, merge = 0;
+    bool scale = false, rules = false, haveK = false;
 
     if (argc == 1) {
-        errs() << "Usage: program input.bc [-n runs_no] [-k K]\n";
+        errs() << "Usage: program input.bc [-n runs_no] [-k K] "
+            "[-t threads] [-scale] [-rules]\n"
+            "       program -merge nodes_no\n";
         SMD.print(argv[0], errs());
         return 1;
     }
 
+    if (strcmp(argv[1], "-merge") == 0) {
+        if (argc > 2)
+            merge = atoi(argv[2]);
+        mergePerf(context, merge ? merge : 10000);
+        return 0;
+    }
+
     // handle options
     for (int i = 2; i < argc; ++i) {
         if (strcmp(argv[i], "-k") == 0)
-            if (i + 1 < argc)
+            if (i + 1 < argc) {
                 if (strcmp(argv[i + 1], "andersen") == 0)
                     K = UINT_MAX;
                 else
                     K = atoi(argv[i + 1]);
-            else
+                haveK = true;
+            } else
                 errs() << "Wrong K\n";
         else if (strcmp(argv[i], "-n") == 0)
             if (i + 1 < argc)
                 N = atoi(argv[i + 1]);
             else
                 errs() << "Wrong N\n";
+        else if (strcmp(argv[i], "-t") == 0)
+            if (i + 1 < argc)
+                T = atoi(argv[i + 1]);
+            else
+                errs() << "Wrong T\n";
+        else if (strcmp(argv[i], "-scale") == 0)
+            scale = true;
+        else if (strcmp(argv[i], "-rules") == 0)
+            rules = true;
+    }
+
+    // K below 4 gives a single category run, which leaves nothing
+    // for more threads to share.
+    if (scale && !haveK)
+        K = 16;
+    if (scale && K > 0 && K < 4) {
+        errs() << "-scale needs several category runs, use -k 4 or more\n";
+        return 1;
     }
 
     M = ParseIRFile(argv[1], SMD, context);
@@ -115,11 +291,27 @@ int main(int argc, char **argv)
     if (!N)
 	N = 1000 / K;
 
+    if (!T)
+        T = 1;
+
+    if (rules) {
+        rulesPerf(*M, N);
+        delete M;
+        return 0;
+    }
+
+    if (scale) {
+        scalingPerf(*M, N, K, T);
+        delete M;
+        return 0;
+    }
+
     // compute performance
-    Measurement = pointsToPerf(*M, N, K);
+    Measurement = pointsToPerf(*M, N, K, T);
     double sec = (double) Measurement / 1000000000;
     errs() << "Sec: " << sec << "\n";
     errs() << "MSec: " << sec * 1000 << "\n";
+    errs() << "Peak RSS (KB): " << peakRSS() << "\n";
 
     delete M;
 
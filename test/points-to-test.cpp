@@ -1,9 +1,12 @@
 #include <llvm/LLVMContext.h>
 #include <llvm/Function.h>
 #include <llvm/Module.h>
+#include <llvm/ValueSymbolTable.h>
+#include <llvm/Assembly/Parser.h>
 #include <llvm/Support/IRReader.h>
 #include <llvm/Support/raw_ostream.h>
 #include <cassert>
+#include <vector>
 
 #include "../src/PointsTo/PointsTo.h"
 #include "PTGTester.h"
@@ -1043,6 +1046,204 @@ static void toPointsToSets3(void)
         errs() << "pts-to sets (3): " << __func__ << "\n";
 }
 
+// equal sets are one interned set, a change makes a new one
+static void sharedSets(void)
+{
+    typedef ptr::PointsToSets::PointsToSet PTSet;
+
+    std::vector<Pointee> Ptees;
+    const char *Names[] = { "sh_a", "sh_b", "sh_c", "sh_d" };
+    for (unsigned I = 0; I < 4; ++I)
+        Ptees.push_back(getPointer(M, Names[I], 0));
+
+    std::size_t Interned = PTSet::getNumInterned();
+    PTSet A, B, C;
+
+    A.insert(Ptees[0]);
+    A.insert(Ptees[1]);
+    check(B.insert(Ptees.begin(), Ptees.begin() + 2), "bulk insert changes");
+    check(!B.insert(Ptees.begin(), Ptees.begin() + 2),
+          "bulk insert of present pointees does not change");
+
+    check(A == B, "equal sets are shared");
+    check(A.getIdentity() == B.getIdentity(), "equal sets are one storage");
+    check(PTSet::getNumInterned() == Interned + 1, "one set is interned");
+
+    C = A;
+    C.insert(Ptees[2]);
+    check(A.size() == 2 && !A.count(Ptees[2]), "a copy changes alone");
+    check(C.size() == 3 && C.count(Ptees[2]), "the copy has the pointee");
+    std::size_t Known = ptr::PointeeIndex::size();
+    check(!C.count(getPointer(M, "sh_never", 0)),
+          "count of an unknown pointee");
+    check(ptr::PointeeIndex::size() == Known, "count does not intern");
+
+    C.intersectWith(B);
+    check(C == A, "intersection gives back the shared set");
+
+    A.clear();
+    B.clear();
+    C.clear();
+    check(PTSet::getNumInterned() == Interned, "released sets are freed");
+}
+
+// merged nodes are found through their representative
+static void unionFind1(void)
+{
+    ptr::PointsToGraph PTG(PS, new ptr::AllInOneCategory);
+    ptr::PointsToSets A;
+
+    PTGTester T(&PTG);
+
+    addPointsTo(M, T, "uf_a", "uf_b");
+    addPointsTo(M, T, "uf_d", "uf_e");
+    addPointsTo(M, T, "uf_f", "uf_g");
+    // {b} and {e} merge, then {b, e} and {g}, d and f keep edges
+    // to the absorbed nodes
+    addPointsTo(M, T, "uf_a", "uf_e");
+    addPointsTo(M, T, "uf_d", "uf_g");
+    // the edge goes to the representative, so e and g get it too
+    addPointsTo(M, T, "uf_b", "uf_x");
+
+    const char *Pointers[] = { "uf_a", "uf_d", "uf_f" };
+    const char *Merged[] = { "uf_b", "uf_e", "uf_g" };
+    for (unsigned I = 0; I < 3; ++I)
+        for (unsigned J = 0; J < 3; ++J)
+            addPointsTo(M, A, Pointers[I], Merged[J]);
+    for (unsigned I = 0; I < 3; ++I)
+        addPointsTo(M, A, Merged[I], "uf_x");
+
+    if (!check(T, A))
+        errs() << "pts-to sets: " << __func__ << "\n";
+
+    check(PTG.getMerges() == 2, "unionFind1: two merges");
+}
+
+// enough pointers for several runs whatever K is guessed from
+static const char *threadsIR =
+    "@g1 = global i32 0\n"
+    "@g2 = global i32 0\n"
+    "@gp = global i32* null\n"
+    "@gpp = global i32** null\n"
+    "define void @f(i32** %pp, i32* %q) {\n"
+    "entry:\n"
+    "  %a = alloca i32*\n"
+    "  %b = alloca i32*\n"
+    "  %c = alloca i32**\n"
+    "  %d = alloca i32**\n"
+    "  %x = alloca i32\n"
+    "  store i32* @g1, i32** %a\n"
+    "  store i32* @g2, i32** %b\n"
+    "  store i32* %x, i32** %b\n"
+    "  store i32** %a, i32*** %c\n"
+    "  store i32** %b, i32*** %d\n"
+    "  store i32** %pp, i32*** %c\n"
+    "  store i32* %q, i32** %pp\n"
+    "  %l = load i32*** %c\n"
+    "  %m = load i32** %l\n"
+    "  store i32* %m, i32** @gp\n"
+    "  %n = load i32*** %d\n"
+    "  store i32** %n, i32*** @gpp\n"
+    "  %o = load i32** %n\n"
+    "  store i32* %o, i32** %a\n"
+    "  ret void\n"
+    "}\n"
+    "define void @main() {\n"
+    "entry:\n"
+    "  %p = alloca i32*\n"
+    "  %y = alloca i32\n"
+    "  store i32* %y, i32** %p\n"
+    "  call void @f(i32** %p, i32* @g1)\n"
+    "  %r = load i32*** @gpp\n"
+    "  call void @f(i32** %r, i32* %y)\n"
+    "  ret void\n"
+    "}\n";
+
+// the parallel reduction must give what the serial runs give
+static void threadsEqualSerial(void)
+{
+    SMDiagnostic SMD;
+    Module m("threads-test", getGlobalContext());
+
+    if (!ParseAssemblyString(threadsIR, &m, SMD, getGlobalContext())) {
+        SMD.print("points-to-test", errs());
+        notTested("threads equal serial");
+        return;
+    }
+
+    ptr::ProgramStructure P(m);
+    unsigned int Ks[] = { 0, 4, 64 };
+
+    for (unsigned int I = 0; I < sizeof(Ks) / sizeof(Ks[0]); ++I) {
+        ptr::PointsToSets Serial, Parallel;
+
+        computePointsToSets(P, Serial, Ks[I], 1);
+        computePointsToSets(P, Parallel, Ks[I], 4);
+
+        if (!check(Serial, Parallel))
+            errs() << "threads differ for K=" << Ks[I] << ": "
+                   << __func__ << "\n";
+    }
+}
+
+// ri and rc differ only in the pointee of the returned pointer
+static const char *returnsIR =
+    "@a = global i32 0\n"
+    "@b = global i8 0\n"
+    "@fp = global i32* ()* null\n"
+    "define i32* @ri() {\n"
+    "entry:\n"
+    "  ret i32* @a\n"
+    "}\n"
+    "define i8* @rc() {\n"
+    "entry:\n"
+    "  ret i8* @b\n"
+    "}\n"
+    "define void @main() {\n"
+    "entry:\n"
+    "  store i32* ()* @ri, i32* ()** @fp\n"
+    "  %f = load i32* ()** @fp\n"
+    "  %r = call i32* %f()\n"
+    "  %s = call i8* @rc()\n"
+    "  ret void\n"
+    "}\n";
+
+static bool pointsTo(const ptr::PointsToSets::PointsToSet &S, const Value *V)
+{
+    for (ptr::PointsToSets::PointsToSet::const_iterator I = S.begin(),
+         E = S.end(); I != E; ++I)
+        if (I->first == V)
+            return true;
+
+    return false;
+}
+
+// an indirect call returns only from functions of its exact return type
+static void indirectReturnType(void)
+{
+    SMDiagnostic SMD;
+    Module m("returns-test", getGlobalContext());
+
+    if (!ParseAssemblyString(returnsIR, &m, SMD, getGlobalContext())) {
+        SMD.print("points-to-test", errs());
+        notTested("indirect return type");
+        return;
+    }
+
+    ptr::ProgramStructure P(m);
+    ptr::PointsToSets S;
+
+    computePointsToSets(P, S);
+
+    const Value *R = m.getFunction("main")->getValueSymbolTable().lookup("r");
+    const ptr::PointsToSets::PointsToSet &RS = ptr::getPointsToSet(R, S);
+
+    check(pointsTo(RS, m.getGlobalVariable("a")),
+          "indirectReturnType: the call returns @a");
+    check(!pointsTo(RS, m.getGlobalVariable("b")),
+          "indirectReturnType: i8* is not returned to i32*");
+}
+
 int main(int argc, char **argv)
 {
 	LLVMContext context;
@@ -1104,6 +1305,10 @@ int main(int argc, char **argv)
     toPointsToSets1();
     toPointsToSets2();
     toPointsToSets3();
+    sharedSets();
+    unionFind1();
+    threadsEqualSerial();
+    indirectReturnType();
 
     std::pair<int, int>results = getResults();
 
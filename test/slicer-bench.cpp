@@ -0,0 +1,465 @@
+#include <llvm/InitializePasses.h>
+#include <llvm/LLVMContext.h>
+#include <llvm/Module.h>
+#include <llvm/Pass.h>
+#include <llvm/PassManager.h>
+#include <llvm/ADT/OwningPtr.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/IRReader.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/system_error.h>
+#include <llvm/Support/raw_ostream.h>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../src/Cache/AnalysisPasses.h"
+#include "../src/Support/Json.h"
+#include "../src/Support/Trace.h"
+
+using namespace llvm;
+
+// Runs -create-hammock-cfg -slice-inter on every input the way opt does and
+// reports the time of the whole pipeline and of its phases, as recorded by
+// the trace scopes of the analyses. Every input runs in a process of its
+// own, so that its peak RSS does not depend on the inputs before it. The
+// results can be stored as a baseline and later runs compared against it.
+
+typedef std::map<std::string, double> Metrics;
+typedef std::map<std::string, Metrics> Results;
+
+// metrics in the order they are printed, rss is in KB, the rest in ms
+static const char *const MetricNames[] = {
+    "wall", "cpu", "rss", "parse", "pta", "callgraph", "modifies",
+    "functions", "propagation", "slice-module"
+};
+static const unsigned NumMetrics = sizeof(MetricNames) / sizeof(*MetricNames);
+
+static double msecs(const trace::Totals &T, const char *Name)
+{
+    trace::Totals::const_iterator I = T.find(Name);
+    return I == T.end() ? 0 : I->second / 1000.0;
+}
+
+static double cpuTime(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+    return t.tv_sec * 1000.0 + t.tv_nsec / 1000000.0;
+}
+
+static double wallTime(void)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count() /
+        1000.0;
+}
+
+
+static Metrics benchFile(const char *file, int N)
+{
+    PassRegistry &Registry = *PassRegistry::getPassRegistry();
+    const PassInfo *Hammock = Registry.getPassInfo("create-hammock-cfg");
+    const PassInfo *Slicer = Registry.getPassInfo("slice-inter");
+    Metrics R;
+
+    if (!Hammock || !Slicer) {
+        errs() << "Slicer passes are not registered\n";
+        exit(1);
+    }
+
+    for (int I = 0; I < N; ++I) {
+        SMDiagnostic SMD;
+        LLVMContext context;
+
+        double parseStart = wallTime();
+        OwningPtr<Module> M(ParseIRFile(file, SMD, context));
+        R["parse"] += wallTime() - parseStart;
+
+        if (!M) {
+            SMD.print("slicer-bench", errs());
+            exit(1);
+        }
+
+        PassManager PM;
+        PM.add(Hammock->createPass());
+        PM.add(Slicer->createPass());
+
+        trace::takeTotals();
+
+        double wall = wallTime(), cpu = cpuTime();
+        PM.run(*M);
+        R["wall"] += wallTime() - wall;
+        R["cpu"] += cpuTime() - cpu;
+
+        // the module is freed at the end of the iteration
+        cache::forgetResults();
+
+        trace::Totals T = trace::takeTotals();
+        double functions = msecs(T, "slicer.construct") +
+            msecs(T, "slicer.round");
+
+        R["pta"] += msecs(T, "pta.program-structure") + msecs(T, "pta");
+        R["callgraph"] += msecs(T, "callgraph");
+        R["modifies"] += msecs(T, "modifies");
+        R["functions"] += functions;
+        R["slice-module"] += msecs(T, "slicer.slice-module");
+        R["propagation"] += msecs(T, "slice-inter") - functions -
+            msecs(T, "slicer.slice-module");
+    }
+
+    for (Metrics::iterator I = R.begin(); I != R.end(); ++I)
+        I->second /= N;
+
+    return R;
+}
+
+// Runs benchFile in a child process, so that the peak RSS is of this input
+// alone and not of the biggest input so far. The child sends the metrics
+// back as "name value" lines.
+static Metrics benchFileForked(const char *file, int N)
+{
+    int fds[2];
+
+    if (pipe(fds)) {
+        perror("pipe");
+        exit(1);
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(1);
+    }
+
+    if (!pid) {
+        close(fds[0]);
+
+        Metrics R = benchFile(file, N);
+        std::string Out;
+        {
+            raw_string_ostream OS(Out);
+            for (Metrics::const_iterator I = R.begin(); I != R.end(); ++I)
+                OS << I->first << ' ' << format("%.6f", I->second) << '\n';
+        }
+
+        for (std::size_t Done = 0; Done < Out.size(); ) {
+            ssize_t W = write(fds[1], Out.data() + Done, Out.size() - Done);
+            if (W <= 0)
+                _exit(1);
+            Done += W;
+        }
+        _exit(0);
+    }
+
+    close(fds[1]);
+
+    std::string In;
+    char buf[4096];
+    ssize_t Read;
+    while ((Read = read(fds[0], buf, sizeof(buf))) > 0)
+        In.append(buf, Read);
+    close(fds[0]);
+
+    int status;
+    struct rusage ru;
+    if (wait4(pid, &status, 0, &ru) < 0 || !WIFEXITED(status) ||
+        WEXITSTATUS(status)) {
+        errs() << "Benchmark of " << file << " failed\n";
+        exit(1);
+    }
+
+    Metrics R;
+    SmallVector<StringRef, 16> Lines;
+    StringRef(In).split(Lines, "\n", -1, false);
+    for (unsigned i = 0; i < Lines.size(); ++i) {
+        std::pair<StringRef, StringRef> NV = Lines[i].split(' ');
+        R[NV.first.str()] = strtod(NV.second.str().c_str(), NULL);
+    }
+
+    // in kilobytes on linux
+    R["rss"] = ru.ru_maxrss;
+
+    return R;
+}
+
+static void writeResults(raw_ostream &OS, const Results &Res, int N)
+{
+    OS << "{\n  \"runs\": " << N << ",\n  \"inputs\": {";
+    for (Results::const_iterator I = Res.begin(); I != Res.end(); ++I) {
+        OS << (I == Res.begin() ? "\n" : ",\n") << "    ";
+        json::writeString(OS, I->first);
+        OS << ": {";
+        for (unsigned K = 0; K < NumMetrics; ++K) {
+            Metrics::const_iterator V = I->second.find(MetricNames[K]);
+            OS << (K ? ", " : " ") << '"' << MetricNames[K] << "\": " <<
+                format("%.3f", V == I->second.end() ? 0.0 : V->second);
+        }
+        OS << " }";
+    }
+    OS << "\n  }\n}\n";
+}
+
+// Reads back what writeResults wrote: objects, strings with the escapes of
+// json::writeString and numbers. Only the numbers under "inputs" are kept.
+class BaselineReader {
+public:
+    BaselineReader(StringRef Buf) : P(Buf.begin()), E(Buf.end()) {}
+
+    bool read(Results &Res) {
+        std::vector<std::string> Path;
+        return readValue(Path, Res) && (skipSpace(), P == E);
+    }
+
+private:
+    void skipSpace() {
+        while (P != E && isspace(*P))
+            ++P;
+    }
+
+    bool readString(std::string &S) {
+        skipSpace();
+        if (P == E || *P != '"')
+            return false;
+        S.clear();
+        for (++P; P != E && *P != '"'; ++P) {
+            if (*P != '\\') {
+                S += *P;
+                continue;
+            }
+            if (++P == E)
+                return false;
+            switch (*P) {
+            case 'b': S += '\b'; break;
+            case 'f': S += '\f'; break;
+            case 'n': S += '\n'; break;
+            case 'r': S += '\r'; break;
+            case 't': S += '\t'; break;
+            case 'u': {
+                // only control characters are written this way
+                if (E - P < 5)
+                    return false;
+                S += (char)strtoul(std::string(P + 1, P + 5).c_str(), NULL,
+                                   16);
+                P += 4;
+                break;
+            }
+            default:
+                S += *P;
+            }
+        }
+        if (P == E)
+            return false;
+        ++P;
+        return true;
+    }
+
+    bool readValue(std::vector<std::string> &Path, Results &Res) {
+        skipSpace();
+        if (P == E)
+            return false;
+
+        if (*P != '{') {
+            char *End;
+            double D = strtod(P, &End);
+            if (End == P || End > E)
+                return false;
+            P = End;
+            if (Path.size() == 3 && Path[0] == "inputs")
+                Res[Path[1]][Path[2]] = D;
+            return true;
+        }
+
+        ++P;
+        skipSpace();
+        if (P != E && *P == '}') {
+            ++P;
+            return true;
+        }
+
+        while (true) {
+            std::string Key;
+            if (!readString(Key))
+                return false;
+            skipSpace();
+            if (P == E || *P++ != ':')
+                return false;
+
+            Path.push_back(Key);
+            bool ok = readValue(Path, Res);
+            Path.pop_back();
+            if (!ok)
+                return false;
+
+            skipSpace();
+            if (P == E)
+                return false;
+            if (*P == '}') {
+                ++P;
+                return true;
+            }
+            if (*P++ != ',')
+                return false;
+        }
+    }
+
+    const char *P, *E;
+};
+
+static bool readBaseline(const char *file, Results &Res)
+{
+    OwningPtr<MemoryBuffer> buf;
+
+    if (MemoryBuffer::getFile(file, buf))
+        return false;
+
+    return BaselineReader(buf->getBuffer()).read(Res);
+}
+
+// Prints all the metrics and returns the number of those slower than the
+// baseline by more than Threshold percent. Differences under a millisecond
+// (or a megabyte of RSS) are noise and never regressions.
+static unsigned compare(const Results &Cur, const Results &Base,
+                        double Threshold)
+{
+    unsigned regressions = 0;
+
+    for (Results::const_iterator I = Cur.begin(); I != Cur.end(); ++I) {
+        Results::const_iterator B = Base.find(I->first);
+
+        errs() << I->first << ":\n";
+        for (unsigned K = 0; K < NumMetrics; ++K) {
+            const char *Name = MetricNames[K];
+            bool isRSS = !strcmp(Name, "rss");
+            Metrics::const_iterator V = I->second.find(Name);
+            double cur = V == I->second.end() ? 0 : V->second;
+
+            errs() << format("  %-14s %12.3f %s", Name, cur,
+                             isRSS ? "KB" : "ms");
+
+            if (B == Base.end()) {
+                errs() << '\n';
+                continue;
+            }
+
+            Metrics::const_iterator BV = B->second.find(Name);
+            if (BV == B->second.end() || BV->second <= 0) {
+                errs() << '\n';
+                continue;
+            }
+
+            double base = BV->second;
+            double change = (cur - base) * 100 / base;
+            bool slower = change > Threshold && cur - base >=
+                (isRSS ? 1024 : 1);
+
+            errs() << format("  (baseline %.3f, %+.1f%%)", base, change);
+            if (slower) {
+                errs() << "  REGRESSION";
+                ++regressions;
+            }
+            errs() << '\n';
+        }
+    }
+
+    return regressions;
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<const char *> inputs;
+    const char *baseline = NULL, *output = NULL;
+    double threshold = 10;
+    bool update = false;
+    int N = 1;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            N = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-baseline") == 0 && i + 1 < argc)
+            baseline = argv[++i];
+        else if (strcmp(argv[i], "-threshold") == 0 && i + 1 < argc)
+            threshold = atof(argv[++i]);
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            output = argv[++i];
+        else if (strcmp(argv[i], "-update") == 0)
+            update = true;
+        else if (argv[i][0] == '-') {
+            errs() << "Unknown option " << argv[i] << "\n";
+            return 1;
+        } else
+            inputs.push_back(argv[i]);
+    }
+
+    if (inputs.empty() || (update && !baseline)) {
+        errs() << "Usage: program input.ll... [-n runs_no] "
+            "[-baseline file.json [-update]] [-threshold percent] "
+            "[-o results.json]\n";
+        return 1;
+    }
+
+    if (N <= 0)
+        N = 1;
+
+    trace::collectTotals();
+
+    PassRegistry &Registry = *PassRegistry::getPassRegistry();
+    initializeCore(Registry);
+    initializeAnalysis(Registry);
+    initializeIPA(Registry);
+    initializeTransformUtils(Registry);
+
+    Results Res;
+    for (unsigned i = 0; i < inputs.size(); ++i)
+        Res[sys::path::filename(inputs[i]).str()] =
+            benchFileForked(inputs[i], N);
+
+    if (output) {
+        std::string err;
+        raw_fd_ostream OS(output, err);
+        if (!err.empty()) {
+            errs() << "Cannot write " << output << ": " << err << "\n";
+            return 1;
+        }
+        writeResults(OS, Res, N);
+    }
+
+    Results Base;
+    if (baseline && !update && !readBaseline(baseline, Base))
+        errs() << "No usable baseline in " << baseline << "\n";
+
+    unsigned regressions = compare(Res, Base, threshold);
+
+    if (update) {
+        std::string err;
+        raw_fd_ostream OS(baseline, err);
+        if (!err.empty()) {
+            errs() << "Cannot write " << baseline << ": " << err << "\n";
+            return 1;
+        }
+        writeResults(OS, Res, N);
+        errs() << "Baseline written to " << baseline << "\n";
+        return 0;
+    }
+
+    if (regressions) {
+        errs() << regressions << " regression(s) over " << threshold <<
+            "%\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include <llvm/InitializePasses.h>
+#include <llvm/LLVMContext.h>
+#include <llvm/Module.h>
+#include <llvm/Pass.h>
+#include <llvm/PassManager.h>
+#include <llvm/Support/IRReader.h>
+#include <llvm/Support/raw_ostream.h>
+#include <ctime>
+
+using namespace llvm;
+
+// run -create-hammock-cfg -slice-inter (or the given pass) on the module
+// the way opt does and measure it, the module is parsed anew for every run
+// since slicing changes it
+static double slicePerf(const char *file, const char *pass, int N)
+{
+    PassRegistry &Registry = *PassRegistry::getPassRegistry();
+    const PassInfo *Hammock = Registry.getPassInfo("create-hammock-cfg");
+    const PassInfo *Slicer = Registry.getPassInfo(pass);
+    double total = 0;
+
+    if (!Hammock || !Slicer) {
+        errs() << "Slicer passes are not registered\n";
+        exit(1);
+    }
+
+    for (int I = 0; I < N; ++I) {
+        LLVMContext context;
+        SMDiagnostic SMD;
+        Module *M = ParseIRFile(file, SMD, context);
+
+        if (!M) {
+            SMD.print("slicer-perf", errs());
+            exit(1);
+        }
+
+        PassManager PM;
+        PM.add(Hammock->createPass());
+        PM.add(Slicer->createPass());
+
+        struct timespec s, e;
+
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &s);
+        PM.run(*M);
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &e);
+
+        total += (e.tv_sec - s.tv_sec) * 1000.0 +
+                 (e.tv_nsec - s.tv_nsec) / 1000000.0;
+
+        delete M;
+    }
+
+    return total / N;
+}
+
+int main(int argc, char **argv)
+{
+    const char *pass = "slice-inter";
+    int N = 1;
+
+    if (argc == 1) {
+        errs() << "Usage: program input.bc [-n runs_no] [-p pass]\n";
+        return 1;
+    }
+
+    for (int i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], "-n") == 0)
+            if (i + 1 < argc)
+                N = atoi(argv[i + 1]);
+            else
+                errs() << "Wrong N\n";
+        else if (strcmp(argv[i], "-p") == 0)
+            if (i + 1 < argc)
+                pass = argv[i + 1];
+            else
+                errs() << "Wrong pass\n";
+    }
+
+    if (N <= 0)
+        N = 1;
+
+    PassRegistry &Registry = *PassRegistry::getPassRegistry();
+    initializeCore(Registry);
+    initializeAnalysis(Registry);
+    initializeIPA(Registry);
+    initializeTransformUtils(Registry);
+
+    errs() << "MSec: " << slicePerf(argv[1], pass, N) << "\n";
+
+    return 0;
+}
@@ -0,0 +1,528 @@
+#include <llvm/Function.h>
+#include <llvm/Instructions.h>
+#include <llvm/LLVMContext.h>
+#include <llvm/Module.h>
+#include <llvm/Pass.h>
+#include <llvm/PassManager.h>
+#include <llvm/ADT/OwningPtr.h>
+#include <llvm/Assembly/Parser.h>
+#include <llvm/Support/InstIterator.h>
+#include <llvm/Support/SourceMgr.h>
+#include <llvm/Support/raw_ostream.h>
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "../src/Cache/AnalysisPasses.h"
+#include "../src/Slicing/StaticSlicer.h"
+
+using namespace llvm;
+
+// Slices small modules the way opt -create-hammock-cfg -slice-inter does
+// and checks which instructions are left, or which are in the slice of
+// each criterion as with -slice-each.
+
+static int failed = 0;
+static int total = 0;
+
+static void check(bool cond, const char *test, const char *msg)
+{
+    ++total;
+
+    if (!cond) {
+        ++failed;
+        errs() << "FAILED: " << test << ": " << msg << "\n";
+    }
+}
+
+static Module *parse(const char *IR, LLVMContext &C)
+{
+    SMDiagnostic SMD;
+    Module *M = ParseAssemblyString(IR, 0, SMD, C);
+
+    if (!M) {
+        SMD.print("slicer-test", errs());
+        abort();
+    }
+
+    return M;
+}
+
+static void runPass(Module &M, const char *Name)
+{
+    PassRegistry &Registry = *PassRegistry::getPassRegistry();
+    const PassInfo *Hammock = Registry.getPassInfo("create-hammock-cfg");
+    const PassInfo *Slicer = Registry.getPassInfo(Name);
+
+    if (!Hammock || !Slicer) {
+        errs() << "Slicer passes are not registered\n";
+        abort();
+    }
+
+    PassManager PM;
+    PM.add(Hammock->createPass());
+    PM.add(Slicer->createPass());
+    PM.run(M);
+
+    // the module is freed by the caller
+    cache::forgetResults();
+}
+
+// stores in F through a pointer named Ptr
+static unsigned storesTo(Module &M, const char *F, const char *Ptr)
+{
+    unsigned N = 0;
+
+    for (inst_iterator I = inst_begin(M.getFunction(F)),
+         E = inst_end(M.getFunction(F)); I != E; ++I)
+        if (const StoreInst *SI = dyn_cast<StoreInst>(&*I))
+            if (SI->getPointerOperand()->getName() == Ptr)
+                ++N;
+
+    return N;
+}
+
+// calls in F of a function whose name starts with Callee
+static unsigned callsOf(Module &M, const char *F, const char *Callee)
+{
+    unsigned N = 0;
+
+    for (inst_iterator I = inst_begin(M.getFunction(F)),
+         E = inst_end(M.getFunction(F)); I != E; ++I)
+        if (const CallInst *CI = dyn_cast<CallInst>(&*I))
+            if (const Function *G = CI->getCalledFunction())
+                if (G->getName().startswith(Callee))
+                    ++N;
+
+    return N;
+}
+
+// memset and memcpy define and read one byte range of the struct
+static const char *rangesIR =
+    "%struct.s = type { i32, i32, i32, i32 }\n"
+    "@__ai_state_1 = common global i32 0\n"
+    "declare void @__assert_fail(i8*, i8*, i32, i8*)\n"
+    "declare void @llvm.memset.p0i8.i64(i8*, i8, i64, i32, i1)\n"
+    "declare void @llvm.memcpy.p0i8.p0i8.i64(i8*, i8*, i64, i32, i1)\n"
+    "define i32 @main() {\n"
+    "entry:\n"
+    "  %s = alloca %struct.s\n"
+    "  %f0 = getelementptr inbounds %struct.s* %s, i32 0, i32 0\n"
+    "  %f3 = getelementptr inbounds %struct.s* %s, i32 0, i32 3\n"
+    "  store i32 7, i32* %f0\n"  // overwritten by the memset
+    "  store i32 5, i32* %f3\n"  // not
+    "  %sb = bitcast %struct.s* %s to i8*\n"
+    "  call void @llvm.memset.p0i8.i64(i8* %sb, i8 0, i64 8, i32 4, i1 false)\n"
+    "  %t = alloca %struct.s\n"
+    "  %u = alloca %struct.s\n"
+    "  %t1 = getelementptr inbounds %struct.s* %t, i32 0, i32 1\n"
+    "  %t3 = getelementptr inbounds %struct.s* %t, i32 0, i32 3\n"
+    "  store i32 2, i32* %t1\n"  // copied by the memcpy
+    "  store i32 3, i32* %t3\n"  // not
+    "  %tb = bitcast %struct.s* %t to i8*\n"
+    "  %ub = bitcast %struct.s* %u to i8*\n"
+    "  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %ub, i8* %tb, i64 8, i32 4, i1 false)\n"
+    "  %u1 = getelementptr inbounds %struct.s* %u, i32 0, i32 1\n"
+    "  %v0 = load i32* %f0\n"
+    "  %v3 = load i32* %f3\n"
+    "  %w = load i32* %u1\n"
+    "  %a = add i32 %v0, %v3\n"
+    "  %b = add i32 %a, %w\n"
+    "  store i32 %b, i32* @__ai_state_1\n"
+    "  ret i32 0\n"
+    "}\n";
+
+static void byteRanges(void)
+{
+    LLVMContext C;
+    OwningPtr<Module> M(parse(rangesIR, C));
+
+    runPass(*M, "slice-inter");
+
+    check(callsOf(*M, "main", "llvm.memset") == 1, __func__,
+          "memset of read bytes is kept");
+    check(storesTo(*M, "main", "f0") == 0, __func__,
+          "store covered by the memset is sliced away");
+    check(storesTo(*M, "main", "f3") == 1, __func__,
+          "store after the memset range is kept");
+    check(callsOf(*M, "main", "llvm.memcpy") == 1, __func__,
+          "memcpy of read bytes is kept");
+    check(storesTo(*M, "main", "t1") == 1, __func__,
+          "store into the copied range is kept");
+    check(storesTo(*M, "main", "t3") == 0, __func__,
+          "store out of the copied range is sliced away");
+}
+
+// a store kills the relevance of the variable it covers
+static const char *killsIR =
+    "%struct.p = type { i32, i32 }\n"
+    "@__ai_state_1 = common global i32 0\n"
+    "declare void @__assert_fail(i8*, i8*, i32, i8*)\n"
+    "define i32 @main() {\n"
+    "entry:\n"
+    "  %w = alloca i32\n"
+    "  %z = alloca i32\n"
+    "  %p = alloca %struct.p\n"
+    "  %p0 = getelementptr inbounds %struct.p* %p, i32 0, i32 0\n"
+    "  %p1 = getelementptr inbounds %struct.p* %p, i32 0, i32 1\n"
+    "  store i32 3, i32* %w\n"   // killed by the next one
+    "  store i32 4, i32* %w\n"
+    "  store i32 5, i32* %z\n"   // never read
+    "  store i32 6, i32* %p0\n"  // other field than the one read
+    "  store i32 7, i32* %p1\n"
+    "  %wv = load i32* %w\n"
+    "  %pv = load i32* %p1\n"
+    "  %a = add i32 %wv, %pv\n"
+    "  store i32 %a, i32* @__ai_state_1\n"
+    "  ret i32 0\n"
+    "}\n";
+
+static void kills(void)
+{
+    LLVMContext C;
+    OwningPtr<Module> M(parse(killsIR, C));
+
+    runPass(*M, "slice-inter");
+
+    check(storesTo(*M, "main", "w") == 1, __func__,
+          "only the last store to w is kept");
+    check(storesTo(*M, "main", "z") == 0, __func__,
+          "store to an unread variable is sliced away");
+    check(storesTo(*M, "main", "p0") == 0, __func__,
+          "store to an unread field is sliced away");
+    check(storesTo(*M, "main", "p1") == 1, __func__,
+          "store to the read field is kept");
+}
+
+// y reaches the criterion only through x in the next iteration, so the
+// relevance has to go around the back edge
+static const char *loopIR =
+    "@__ai_state_1 = common global i32 0\n"
+    "declare void @__assert_fail(i8*, i8*, i32, i8*)\n"
+    "define i32 @main() {\n"
+    "entry:\n"
+    "  %x = alloca i32\n"
+    "  %y = alloca i32\n"
+    "  %z = alloca i32\n"
+    "  %i = alloca i32\n"
+    "  store i32 0, i32* %x\n"
+    "  store i32 1, i32* %y\n"
+    "  store i32 2, i32* %z\n"
+    "  store i32 0, i32* %i\n"
+    "  br label %loop\n"
+    "loop:\n"
+    "  %iv = load i32* %i\n"
+    "  %c = icmp slt i32 %iv, 10\n"
+    "  br i1 %c, label %body, label %exit\n"
+    "body:\n"
+    "  %yv = load i32* %y\n"
+    "  store i32 %yv, i32* %x\n"
+    "  %yn = add i32 %yv, 1\n"
+    "  store i32 %yn, i32* %y\n"
+    "  %zv = load i32* %z\n"
+    "  %zn = add i32 %zv, 1\n"
+    "  store i32 %zn, i32* %z\n"
+    "  %in = add i32 %iv, 1\n"
+    "  store i32 %in, i32* %i\n"
+    "  br label %loop\n"
+    "exit:\n"
+    "  %xv = load i32* %x\n"
+    "  store i32 %xv, i32* @__ai_state_1\n"
+    "  ret i32 0\n"
+    "}\n";
+
+static void loop(void)
+{
+    LLVMContext C;
+    OwningPtr<Module> M(parse(loopIR, C));
+
+    runPass(*M, "slice-inter");
+
+    check(storesTo(*M, "main", "x") == 2, __func__,
+          "both stores to x are kept");
+    check(storesTo(*M, "main", "y") == 2, __func__,
+          "stores to y are kept through the back edge");
+    check(storesTo(*M, "main", "i") == 2, __func__,
+          "stores to the loop counter are kept");
+    check(storesTo(*M, "main", "z") == 0, __func__,
+          "stores to z are sliced away");
+}
+
+// slices of all the criteria at once, of each alone, in reverse order, with
+// 4 threads and in rounds over all functions instead of over SCCs
+static std::vector<BitVector> Together, Alone, Reversed, Parallel, Rounds;
+
+namespace {
+    class SliceEachTester : public ModulePass {
+    public:
+        static char ID;
+
+        SliceEachTester() : ModulePass(ID) {}
+
+        virtual bool runOnModule(Module &M);
+
+        void getAnalysisUsage(AnalysisUsage &AU) const {
+            AU.addRequired<PostDominanceFrontier>();
+            AU.addRequired<cache::PointsToAnalysis>();
+            AU.addRequired<cache::CallgraphAnalysis>();
+            AU.addRequired<cache::ModifiesAnalysis>();
+            AU.setPreservesAll();
+        }
+    };
+}
+
+static RegisterPass<SliceEachTester> X("test-slice-each",
+        "Slices every criterion together and alone");
+char SliceEachTester::ID;
+
+bool SliceEachTester::runOnModule(Module &M)
+{
+    const ptr::PointsToSets &PS =
+        getAnalysis<cache::PointsToAnalysis>().getPointsToSets();
+    const callgraph::Callgraph &CG =
+        getAnalysis<cache::CallgraphAnalysis>().getCallgraph();
+    const mods::Modifies &MOD =
+        getAnalysis<cache::ModifiesAnalysis>().getModifies();
+    slicing::Criteria C;
+
+    for (Module::const_iterator f = M.begin(); f != M.end(); ++f)
+        if (!f->isDeclaration())
+            slicing::findCriteria(*f, C);
+
+    slicing::StaticSlicer All(this, M, PS, CG, MOD, false);
+    All.computeSlices(C, Together);
+
+    // a fresh slicer has no state of other criteria to restore
+    Alone.clear();
+    for (unsigned c = 0; c < C.size(); ++c) {
+        slicing::StaticSlicer One(this, M, PS, CG, MOD, false);
+        std::vector<BitVector> slices;
+        One.computeSlices(slicing::Criteria(1, C[c]), slices);
+        Alone.push_back(slices[0]);
+    }
+
+    slicing::StaticSlicer Back(this, M, PS, CG, MOD, false);
+    Back.computeSlices(slicing::Criteria(C.rbegin(), C.rend()), Reversed);
+    std::reverse(Reversed.begin(), Reversed.end());
+
+    slicing::StaticSlicer Threads(this, M, PS, CG, MOD, false);
+    Threads.setThreads(4);
+    Threads.computeSlices(C, Parallel);
+
+    slicing::StaticSlicer AllFunctions(this, M, PS, CG, MOD, false);
+    AllFunctions.setRounds(true);
+    AllFunctions.computeSlices(C, Rounds);
+
+    return false;
+}
+
+// index of the store in F through Ptr among all the instructions, as
+// computeSlices numbers them
+static unsigned storeIndex(Module &M, const char *F, const char *Ptr)
+{
+    unsigned k = 0;
+
+    for (Module::iterator f = M.begin(); f != M.end(); ++f) {
+        if (f->isDeclaration())
+            continue;
+        for (inst_iterator I = inst_begin(*f), E = inst_end(*f); I != E;
+             ++I, ++k)
+            if (const StoreInst *SI = dyn_cast<StoreInst>(&*I))
+                if (f->getName() == F &&
+                    SI->getPointerOperand()->getName() == Ptr)
+                    return k;
+    }
+
+    abort();
+}
+
+// each assert depends on one global only, set in another function
+static const char *criteriaIR =
+    "@gx = global i32 0\n"
+    "@gy = global i32 0\n"
+    "declare void @__assert_fail(i8*, i8*, i32, i8*)\n"
+    "define void @setx() {\n"
+    "entry:\n"
+    "  store i32 1, i32* @gx\n"
+    "  ret void\n"
+    "}\n"
+    "define void @sety() {\n"
+    "entry:\n"
+    "  store i32 2, i32* @gy\n"
+    "  ret void\n"
+    "}\n"
+    "define void @checkx() {\n"
+    "entry:\n"
+    "  %x = load i32* @gx\n"
+    "  %c = icmp sge i32 %x, 0\n"
+    "  br i1 %c, label %ok, label %fail\n"
+    "fail:\n"
+    "  call void @__assert_fail(i8* null, i8* null, i32 1, i8* null)\n"
+    "  unreachable\n"
+    "ok:\n"
+    "  ret void\n"
+    "}\n"
+    "define void @checky() {\n"
+    "entry:\n"
+    "  %y = load i32* @gy\n"
+    "  %c = icmp sge i32 %y, 0\n"
+    "  br i1 %c, label %ok, label %fail\n"
+    "fail:\n"
+    "  call void @__assert_fail(i8* null, i8* null, i32 2, i8* null)\n"
+    "  unreachable\n"
+    "ok:\n"
+    "  ret void\n"
+    "}\n"
+    "define i32 @main() {\n"
+    "entry:\n"
+    "  call void @setx()\n"
+    "  call void @sety()\n"
+    "  call void @checkx()\n"
+    "  call void @checky()\n"
+    "  ret i32 0\n"
+    "}\n";
+
+static void perCriterion(void)
+{
+    LLVMContext C;
+    OwningPtr<Module> M(parse(criteriaIR, C));
+
+    runPass(*M, "test-slice-each");
+
+    if (Together.size() != 2 || Alone.size() != 2 || Reversed.size() != 2) {
+        check(false, __func__, "two criteria are found");
+        return;
+    }
+
+    unsigned sx = storeIndex(*M, "setx", "gx"),
+             sy = storeIndex(*M, "sety", "gy");
+
+    check(Together[0] != Together[1], __func__,
+          "independent criteria have different slices");
+    check(Together[0].test(sx) && !Together[0].test(sy), __func__,
+          "the first assert depends on the store to gx only");
+    check(Together[1].test(sy) && !Together[1].test(sx), __func__,
+          "the second assert depends on the store to gy only");
+    check(Together[0] == Alone[0] && Together[1] == Alone[1], __func__,
+          "slicing after another criterion is slicing alone");
+    check(Reversed[0] == Alone[0] && Reversed[1] == Alone[1], __func__,
+          "the order of the criteria does not matter");
+}
+
+// the four callees of main are one batch, sliced by the threads together
+static void threadsEqualSerial(void)
+{
+    LLVMContext C;
+    OwningPtr<Module> M(parse(criteriaIR, C));
+
+    runPass(*M, "test-slice-each");
+
+    check(Parallel.size() == Together.size(), __func__,
+          "every criterion is sliced with threads");
+    check(Parallel == Together, __func__,
+          "4 threads give the slices of 1 thread");
+}
+
+// gy flows to gx and back only through the recursion of even and odd
+static const char *recursionIR =
+    "@gx = global i32 0\n"
+    "@gy = global i32 0\n"
+    "@gz = global i32 0\n"
+    "declare void @__assert_fail(i8*, i8*, i32, i8*)\n"
+    "define void @even(i32 %n) {\n"
+    "entry:\n"
+    "  %c = icmp eq i32 %n, 0\n"
+    "  br i1 %c, label %done, label %rec\n"
+    "rec:\n"
+    "  %v = load i32* @gy\n"
+    "  store i32 %v, i32* @gx\n"
+    "  %m = sub i32 %n, 1\n"
+    "  call void @odd(i32 %m)\n"
+    "  br label %done\n"
+    "done:\n"
+    "  ret void\n"
+    "}\n"
+    "define void @odd(i32 %n) {\n"
+    "entry:\n"
+    "  %c = icmp eq i32 %n, 0\n"
+    "  br i1 %c, label %done, label %rec\n"
+    "rec:\n"
+    "  %v = load i32* @gx\n"
+    "  store i32 %v, i32* @gy\n"
+    "  store i32 %n, i32* @gz\n"
+    "  %m = sub i32 %n, 1\n"
+    "  call void @even(i32 %m)\n"
+    "  br label %done\n"
+    "done:\n"
+    "  ret void\n"
+    "}\n"
+    "define void @checkx() {\n"
+    "entry:\n"
+    "  %x = load i32* @gx\n"
+    "  %c = icmp sge i32 %x, 0\n"
+    "  br i1 %c, label %ok, label %fail\n"
+    "fail:\n"
+    "  call void @__assert_fail(i8* null, i8* null, i32 1, i8* null)\n"
+    "  unreachable\n"
+    "ok:\n"
+    "  ret void\n"
+    "}\n"
+    "define void @checkz() {\n"
+    "entry:\n"
+    "  %z = load i32* @gz\n"
+    "  %c = icmp sge i32 %z, 0\n"
+    "  br i1 %c, label %ok, label %fail\n"
+    "fail:\n"
+    "  call void @__assert_fail(i8* null, i8* null, i32 2, i8* null)\n"
+    "  unreachable\n"
+    "ok:\n"
+    "  ret void\n"
+    "}\n"
+    "define i32 @main() {\n"
+    "entry:\n"
+    "  store i32 1, i32* @gy\n"
+    "  call void @even(i32 5)\n"
+    "  call void @checkx()\n"
+    "  call void @checkz()\n"
+    "  ret i32 0\n"
+    "}\n";
+
+// the SCC schedule reaches the fixpoint of the rounds over all functions
+static void sccEqualRounds(void)
+{
+    LLVMContext C;
+    OwningPtr<Module> M(parse(recursionIR, C));
+
+    runPass(*M, "test-slice-each");
+
+    if (Together.size() != 2 || Rounds.size() != 2) {
+        check(false, __func__, "two criteria are found");
+        return;
+    }
+
+    check(Together == Rounds, __func__,
+          "SCCs and rounds give the same slices");
+    check(Together[0].test(storeIndex(*M, "main", "gy")), __func__,
+          "relevance goes around the recursion");
+    check(!Together[0].test(storeIndex(*M, "odd", "gz")), __func__,
+          "the store to gz is not in the slice of gx");
+    check(Together[1].test(storeIndex(*M, "odd", "gz")), __func__,
+          "the store to gz is in its own slice");
+}
+
+int main(int argc, char **argv)
+{
+    byteRanges();
+    kills();
+    loop();
+    perCriterion();
+    threadsEqualSerial();
+    sccEqualRounds();
+
+    if (failed)
+        errs() << failed << " tests from " << total << " failed!\n";
+    else
+        errs() << "All tests passed!\n";
+
+    return failed != 0;
+}
@@ -0,0 +1,491 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+//
+// Slices many modules in one go: runs -prepare -create-hammock-cfg
+// -slice-inter, writes the sliced module and runs -kleerer on it, for every
+// file of a list. The files are handed out to a pool of forked workers,
+// each processing one file after another, so startup and pass registration
+// are paid once per worker, not per file. A worker which crashes or runs
+// out of time takes only its current file down and is replaced. A manifest
+// records the status and time of every file.
+//
+
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "llvm/DataLayout.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/PassManager.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/IRReader.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
+
+#include "../src/Cache/AnalysisPasses.h"
+#include "../src/Support/Json.h"
+#include "../src/Support/Parallel.h"
+
+using namespace llvm;
+
+static cl::opt<std::string>
+FileList(cl::Positional, cl::Required,
+         cl::desc("<file with a list of modules, - for stdin>"));
+
+static cl::opt<unsigned>
+Jobs("j", cl::desc("Number of workers (default: hardware threads)"),
+     cl::init(0));
+
+static cl::opt<std::string>
+OutputDir("o", cl::desc("Directory for the outputs, they are written next "
+                        "to the inputs if not given"),
+          cl::value_desc("directory"));
+
+static cl::opt<std::string>
+Manifest("manifest", cl::desc("Where to write the JSON manifest"),
+         cl::value_desc("filename"), cl::init("slicer-batch.json"));
+
+static cl::opt<unsigned>
+Timeout("timeout", cl::desc("Seconds a file may take, 0 for no limit"),
+        cl::init(0));
+
+static cl::opt<bool>
+NoKleerer("no-kleerer", cl::desc("Do not run -kleerer on sliced modules"));
+
+namespace {
+  enum Status { PENDING, OK, ERROR, CRASH, TIMEOUT };
+
+  const char *const StatusNames[] = {
+    "pending", "ok", "error", "crash", "timeout"
+  };
+
+  struct FileResult {
+    FileResult() : status(PENDING), signal(0), msecs(0) {}
+
+    std::string input, output, message;
+    Status status;
+    int signal;
+    double msecs;
+  };
+
+  struct Worker {
+    Worker() : pid(-1), tasks(NULL), results(-1), current(-1),
+      timedOut(false) {}
+
+    pid_t pid;
+    FILE *tasks;     /* parent -> worker, an index per line */
+    int results;     /* worker -> parent, a result per line */
+    int current;     /* index of the file being processed, -1 if idle */
+    bool timedOut;
+    std::chrono::steady_clock::time_point started;
+    std::string buffer;
+  };
+
+  double msecsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count() / 1000.0;
+  }
+
+  std::string outputFor(StringRef input) {
+    if (OutputDir.empty())
+      return input.str() + ".sliced";
+
+    SmallString<128> out(OutputDir);
+    sys::path::append(out, sys::path::relative_path(input));
+    return out.str().str() + ".sliced";
+  }
+
+  /* messages travel in one line with tab separated fields */
+  std::string oneLine(std::string S) {
+    for (unsigned i = 0; i < S.size(); ++i)
+      if (S[i] == '\n' || S[i] == '\t')
+        S[i] = ' ';
+    return S;
+  }
+}
+
+/*
+ * The worker side: slice one file. Everything lives in a context of its
+ * own which is dropped afterwards, together with the results the analysis
+ * passes keep for reuse.
+ */
+static Status sliceFile(const std::string &input, const std::string &output,
+                        std::string &message) {
+  PassRegistry &Registry = *PassRegistry::getPassRegistry();
+  const char *const pipeline[] = {
+    "prepare", "create-hammock-cfg", "slice-inter"
+  };
+  LLVMContext context;
+  SMDiagnostic SMD;
+  OwningPtr<Module> M(ParseIRFile(input, SMD, context));
+
+  if (!M) {
+    std::string diag;
+    raw_string_ostream OS(diag);
+    SMD.print("llvm-slicer-batch", OS);
+    message = OS.str();
+    return ERROR;
+  }
+
+  StringRef dir = sys::path::parent_path(output);
+  bool existed;
+  if (!dir.empty())
+    if (error_code ec = sys::fs::create_directories(dir, existed)) {
+      message = "cannot create " + dir.str() + ": " + ec.message();
+      return ERROR;
+    }
+
+  std::string err;
+  raw_fd_ostream out(output.c_str(), err, raw_fd_ostream::F_Binary);
+  if (!err.empty()) {
+    message = "cannot write " + output + ": " + err;
+    return ERROR;
+  }
+
+  /* -kleerer names its outputs after the module */
+  M->setModuleIdentifier(output);
+
+  PassManager PM;
+  PM.add(new DataLayout(M.get()));
+  for (unsigned i = 0; i < sizeof(pipeline) / sizeof(*pipeline); ++i) {
+    const PassInfo *PI = Registry.getPassInfo(pipeline[i]);
+    if (!PI) {
+      message = std::string("pass not registered: ") + pipeline[i];
+      return ERROR;
+    }
+    PM.add(PI->createPass());
+  }
+  PM.add(createBitcodeWriterPass(out));
+  if (!NoKleerer) {
+    const PassInfo *PI = Registry.getPassInfo("kleerer");
+    if (!PI) {
+      message = "pass not registered: kleerer";
+      return ERROR;
+    }
+    PM.add(PI->createPass());
+  }
+
+  PM.run(*M);
+  cache::forgetResults();
+
+  return OK;
+}
+
+static void workerLoop(const std::vector<FileResult> &files, int tasks,
+                       int results) {
+  FILE *in = fdopen(tasks, "r");
+  char line[32];
+
+  while (fgets(line, sizeof(line), in)) {
+    unsigned idx = strtoul(line, NULL, 10);
+    std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+    std::string message;
+
+    Status status = sliceFile(files[idx].input, files[idx].output, message);
+
+    std::string report = std::string(StatusNames[status]) + '\t' +
+      std::to_string(msecsSince(start)) + '\t' + oneLine(message) + '\n';
+    if (write(results, report.data(), report.size()) !=
+        (ssize_t)report.size())
+      break;
+  }
+
+  _exit(0);
+}
+
+static bool startWorker(std::vector<Worker> &workers, unsigned w,
+                        const std::vector<FileResult> &files) {
+  int tasks[2], results[2];
+
+  if (pipe(tasks))
+    return false;
+  if (pipe(results)) {
+    close(tasks[0]);
+    close(tasks[1]);
+    return false;
+  }
+
+  errs().flush();
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(tasks[0]);
+    close(tasks[1]);
+    close(results[0]);
+    close(results[1]);
+    return false;
+  }
+
+  if (!pid) {
+    /* others must see EOF when the parent closes their pipes */
+    for (unsigned i = 0; i < workers.size(); ++i)
+      if (workers[i].pid > 0) {
+        fclose(workers[i].tasks);
+        close(workers[i].results);
+      }
+    close(tasks[1]);
+    close(results[0]);
+    workerLoop(files, tasks[0], results[1]);
+  }
+
+  close(tasks[0]);
+  close(results[1]);
+
+  Worker &W = workers[w];
+  W = Worker();
+  W.pid = pid;
+  W.tasks = fdopen(tasks[1], "w");
+  W.results = results[0];
+  return true;
+}
+
+static void dispatch(Worker &W, unsigned idx) {
+  W.current = idx;
+  W.timedOut = false;
+  W.buffer.clear();
+  W.started = std::chrono::steady_clock::now();
+  fprintf(W.tasks, "%u\n", idx);
+  fflush(W.tasks);
+}
+
+/* parse "status\tmsecs\tmessage" sent by a worker */
+static void finish(Worker &W, std::vector<FileResult> &files) {
+  FileResult &R = files[W.current];
+  size_t tab1 = W.buffer.find('\t');
+  size_t tab2 = W.buffer.find('\t', tab1 + 1);
+
+  if (tab1 == std::string::npos || tab2 == std::string::npos) {
+    R.status = ERROR;
+    R.message = "malformed report: " + oneLine(W.buffer);
+  } else {
+    R.status = W.buffer.compare(0, tab1, StatusNames[OK]) ? ERROR : OK;
+    R.msecs = atof(W.buffer.c_str() + tab1 + 1);
+    R.message = W.buffer.substr(tab2 + 1, W.buffer.size() - tab2 - 2);
+  }
+  W.current = -1;
+  W.buffer.clear();
+}
+
+/* the worker is gone, its current file (if any) is what killed it */
+static void reap(Worker &W, std::vector<FileResult> &files) {
+  int status = 0;
+
+  fclose(W.tasks);
+  close(W.results);
+  waitpid(W.pid, &status, 0);
+  W.pid = -1;
+
+  if (W.current < 0)
+    return;
+
+  FileResult &R = files[W.current];
+  R.msecs = msecsSince(W.started);
+  if (W.timedOut) {
+    R.status = TIMEOUT;
+  } else {
+    R.status = CRASH;
+    if (WIFSIGNALED(status))
+      R.signal = WTERMSIG(status);
+    else
+      R.message = "worker exited with " + std::to_string(WEXITSTATUS(status));
+  }
+  W.current = -1;
+}
+
+static void writeManifest(raw_ostream &OS,
+                          const std::vector<FileResult> &files,
+                          double msecs) {
+  unsigned counts[TIMEOUT + 1] = { 0 };
+
+  OS << "{\n  \"files\": [";
+  for (unsigned i = 0; i < files.size(); ++i) {
+    const FileResult &R = files[i];
+
+    ++counts[R.status];
+    OS << (i ? ",\n    " : "\n    ") << "{ \"input\": ";
+    json::writeString(OS, R.input);
+    OS << ", \"status\": \"" << StatusNames[R.status] << "\", \"ms\": " <<
+      format("%.3f", R.msecs);
+    if (R.status == OK) {
+      OS << ", \"output\": ";
+      json::writeString(OS, R.output);
+    }
+    if (R.signal)
+      OS << ", \"signal\": " << R.signal;
+    if (!R.message.empty()) {
+      OS << ", \"message\": ";
+      json::writeString(OS, R.message);
+    }
+    OS << " }";
+  }
+
+  OS << "\n  ],\n  \"summary\": {";
+  for (unsigned s = OK; s <= TIMEOUT; ++s)
+    OS << " \"" << StatusNames[s] << "\": " << counts[s] << ',';
+  OS << " \"ms\": " << format("%.3f", msecs) << " }\n}\n";
+}
+
+static bool readFileList(std::vector<FileResult> &files) {
+  OwningPtr<MemoryBuffer> buf;
+
+  if (error_code ec = MemoryBuffer::getFileOrSTDIN(FileList, buf)) {
+    errs() << "Cannot read " << FileList << ": " << ec.message() << '\n';
+    return false;
+  }
+
+  StringRef rest = buf->getBuffer();
+  while (!rest.empty()) {
+    std::pair<StringRef, StringRef> split = rest.split('\n');
+    StringRef name = split.first.trim();
+
+    rest = split.second;
+    if (name.empty() || name[0] == '#')
+      continue;
+
+    FileResult R;
+    R.input = name.str();
+    R.output = outputFor(name);
+    files.push_back(R);
+  }
+
+  return true;
+}
+
+int main(int argc, char **argv) {
+  cl::ParseCommandLineOptions(argc, argv, "batch slicer\n");
+
+  std::vector<FileResult> files;
+  if (!readFileList(files))
+    return 1;
+
+  PassRegistry &Registry = *PassRegistry::getPassRegistry();
+  initializeCore(Registry);
+  initializeAnalysis(Registry);
+  initializeIPA(Registry);
+  initializeTransformUtils(Registry);
+
+  /* a dead worker must not kill us through its pipe */
+  signal(SIGPIPE, SIG_IGN);
+
+  unsigned jobs = Jobs ? Jobs : parallel::hardwareThreads();
+  if (jobs > files.size())
+    jobs = files.size();
+
+  std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
+  std::vector<Worker> workers(jobs);
+  unsigned next = 0, running = 0;
+
+  while (next < files.size() || running) {
+    /* keep every worker busy, starting new ones for the dead */
+    for (unsigned w = 0; w < workers.size() && next < files.size(); ++w) {
+      Worker &W = workers[w];
+
+      if (W.pid < 0) {
+        if (!startWorker(workers, w, files)) {
+          errs() << "Cannot start a worker: " << strerror(errno) << '\n';
+          return 1;
+        }
+        ++running;
+      }
+      if (W.current < 0)
+        dispatch(W, next++);
+    }
+
+    /* idle workers are not needed any more */
+    if (next == files.size())
+      for (unsigned w = 0; w < workers.size(); ++w)
+        if (workers[w].pid > 0 && workers[w].current < 0) {
+          reap(workers[w], files);
+          --running;
+        }
+
+    if (!running)
+      break;
+
+    std::vector<struct pollfd> fds;
+    std::vector<unsigned> owners;
+    int wait = -1;
+
+    for (unsigned w = 0; w < workers.size(); ++w) {
+      Worker &W = workers[w];
+      if (W.pid < 0)
+        continue;
+
+      struct pollfd pfd = { W.results, POLLIN, 0 };
+      fds.push_back(pfd);
+      owners.push_back(w);
+
+      if (Timeout && !W.timedOut) {
+        double left = Timeout * 1000.0 - msecsSince(W.started);
+        if (left <= 0) {
+          kill(W.pid, SIGKILL);
+          W.timedOut = true;
+        } else if (wait < 0 || left < wait)
+          wait = (int)left + 1;
+      }
+    }
+
+    if (poll(&fds[0], fds.size(), wait) < 0 && errno != EINTR) {
+      errs() << "poll failed: " << strerror(errno) << '\n';
+      return 1;
+    }
+
+    for (unsigned i = 0; i < fds.size(); ++i) {
+      if (!fds[i].revents)
+        continue;
+
+      Worker &W = workers[owners[i]];
+      char chunk[4096];
+      ssize_t n = read(W.results, chunk, sizeof(chunk));
+
+      if (n <= 0) {
+        reap(W, files);
+        --running;
+        continue;
+      }
+
+      W.buffer.append(chunk, n);
+      if (W.buffer[W.buffer.size() - 1] == '\n' && W.current >= 0)
+        finish(W, files);
+    }
+  }
+
+  double total = msecsSince(start);
+  std::string err;
+  raw_fd_ostream OS(Manifest.c_str(), err);
+  if (!err.empty()) {
+    errs() << "Cannot write " << Manifest << ": " << err << '\n';
+    return 1;
+  }
+  writeManifest(OS, files, total);
+
+  unsigned failed = 0;
+  for (unsigned i = 0; i < files.size(); ++i)
+    if (files[i].status != OK)
+      ++failed;
+  errs() << files.size() - failed << " of " << files.size() <<
+    " files sliced in " << format("%.1f", total / 1000) << " s\n";
+
+  return failed ? 2 : 0;
+}